@@ -39,12 +39,146 @@
 #include <vector>
 #include <exception>
 #include <map>
+#include <set>
 #include <sstream>
 #include <type_traits>
 #include <iomanip>
 #include <numeric>
+#include <limits>
 #include <chrono>
 #include <iterator>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cctype>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <memory>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#if defined(__unix__) || defined(__APPLE__)
+/** Defined when POSIX facilities (file descriptors, processes) are available. */
+#define LITEST_POSIX 1
+#include <unistd.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+
+/* Environment of the process, to re-execute with; only declared by <unistd.h> with _GNU_SOURCE. */
+extern char **environ;
+#endif
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+/** Defined when LT_NO_SYSCALLS can trap the system calls of a block with a seccomp filter. */
+#define LITEST_SECCOMP 1
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <poll.h>
+#include <ucontext.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <linux/audit.h>
+#endif
+
+#if defined(__linux__) && defined(__cpp_impl_coroutine) && __cplusplus >= 202002L
+/** Defined when async tests (LT_ADD_ASYNC_TEST) are available: C++20 coroutines on Linux. */
+#define LITEST_COROUTINES 1
+#include <coroutine>
+#include <future>
+#include <deque>
+#include <queue>
+#include <system_error>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+/** Environment variable naming the file descriptor that machine-readable results are written to (see litest-run). */
+#define LITEST_REPORT_FD_ENV "LITEST_REPORT_FD"
+
+/** Environment variable holding the CPU list a process was placed on by litest-run, e.g. `4-7`. */
+#define LITEST_CPUS_ENV "LITEST_CPUS"
+
+/** Environment variable set to `1` by litest-run when the CPUs in LITEST_CPUS_ENV are whole physical cores reserved for the process. */
+#define LITEST_EXCLUSIVE_CORES_ENV "LITEST_EXCLUSIVE_CORES"
+
+/** Environment variable naming the directory of LT_CACHED_INPUT files; defaults to `.litest-cache`. */
+#define LITEST_CACHE_DIR_ENV "LITEST_CACHE_DIR"
+
+/** Environment variable passed by the crash handler to the re-executed binary, telling it where to resume. */
+#define LITEST_RESUME_ENV "LITEST_RESUME"
+
+/** Environment variable holding the seed of test runs, overriding TestSuite::seed; decimal or `0x` hexadecimal. */
+#define LITEST_SEED_ENV "LITEST_SEED"
+
+/** *Internal* Environment variable holding a seed chosen at random, used by runs that have no other seed. */
+#define LITEST_AUTO_SEED_ENV "LITEST_AUTO_SEED"
+
+/** Environment variable holding the number of times each test is run to check it is deterministic; see TestSuite::determinismRuns. */
+#define LITEST_DETERMINISM_RUNS_ENV "LITEST_DETERMINISM_RUNS"
+
+/** Environment variable naming a checkpoint journal, if TestSuite::checkpointFile is not set. */
+#define LITEST_CHECKPOINT_ENV "LITEST_CHECKPOINT"
+
+/** Environment variable that makes a TestSuite resume from its checkpoint journal, if set to a non-empty value. */
+#define LITEST_CHECKPOINT_RESUME_ENV "LITEST_CHECKPOINT_RESUME"
+
+/** Environment variable that makes a TestSuite list its assertion sites instead of running tests, if set to a non-empty value. */
+#define LITEST_LIST_SITES_ENV "LITEST_LIST_SITES"
+
+#if defined(__ELF__) && (defined(__GNUC__) || defined(__clang__)) && (defined(__PIE__) || !defined(__PIC__))
+/**
+ Defined when every assertion site is recorded in this linker section, so that all sites are known before any test runs.
+ Not available in shared libraries, where sites are only known once reached.
+ */
+#define LITEST_SITE_SECTION "litest_sites"
+
+/* Bounds of the section, provided by the linker. Weak, since the section is missing from programs without assertions. */
+extern "C" void *const __start_litest_sites[] __attribute__((weak, visibility("hidden")));
+extern "C" void *const __stop_litest_sites[] __attribute__((weak, visibility("hidden")));
+#endif
+
+#if (defined(__unix__) || defined(__APPLE__)) && (defined(__GNUC__) || defined(__clang__))
+/**
+ Defined when reports of AddressSanitizer, ThreadSanitizer and UndefinedBehaviorSanitizer are attributed to the
+ running test. The sanitizer interface is declared weak, so nothing changes in binaries without a sanitizer runtime.
+ */
+#define LITEST_SANITIZER_HOOKS 1
+
+extern "C" void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+
+namespace litest { namespace internal { inline void sanitizerReport(const char *summary); } }
+
+/* Replaces the default of the sanitizer runtimes, which prints the summary line of each report. */
+extern "C" inline __attribute__((used)) void __sanitizer_report_error_summary(const char *summary)
+{
+	litest::internal::sanitizerReport(summary);
+}
+
+/* UndefinedBehaviorSanitizer only calls the above with this option. Options in UBSAN_OPTIONS take precedence. */
+extern "C" inline __attribute__((used)) const char *__ubsan_default_options()
+{
+	return "print_summary=1";
+}
+#endif
 
 /**@{*/
 /** @name Internal-use macros */
@@ -52,17 +186,104 @@
 /** The name of the context argument in the closures generated from other LiTest macros. */
 #define LITEST_CONTEXT_ARG litest_macro_arg_ctx
 
+/** Whether a structure of the module interface, of the size its caller set, has a field. */
+#define LITEST_MODULE_HAS(ptr, field) \
+	((ptr)->size >= offsetof(typename std::remove_pointer<decltype(ptr)>::type, field) + sizeof((ptr)->field))
+
 /** Parameters to a test function. */
 #define LITEST_ARGS litest::TestSuite &LITEST_CONTEXT_ARG
 
+#if defined(__GNUC__) || defined(__clang__)
+/** *Internal* Silence warnings about `Decomposer() <= a == b` in decomposed checks. */
+#define LITEST_INTERNAL_SUPPRESS_PARENTHESES_WARNING _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wparentheses\"")
+/** *Internal* Restore warnings silenced by LITEST_INTERNAL_SUPPRESS_PARENTHESES_WARNING. */
+#define LITEST_INTERNAL_RESTORE_WARNINGS _Pragma("GCC diagnostic pop")
+#else
+#define LITEST_INTERNAL_SUPPRESS_PARENTHESES_WARNING
+#define LITEST_INTERNAL_RESTORE_WARNINGS
+#endif
+
+#ifdef LITEST_SITE_SECTION
+#if __SIZEOF_POINTER__ == 8
+#define LITEST_INTERNAL_POINTER_DIRECTIVE ".balign 8\n\t.quad"
+#else
+#define LITEST_INTERNAL_POINTER_DIRECTIVE ".balign 4\n\t.long"
+#endif
+/**
+ *Internal* Record the address of a static Site in the LITEST_SITE_SECTION linker section.
+ Emitted with inline assembly, as a `section` attribute conflicts between inline and non-inline functions.
+ */
+#define LITEST_INTERNAL_REGISTER_SITE(site)\
+	__asm__(".pushsection " LITEST_SITE_SECTION ",\"aw\"\n\t" LITEST_INTERNAL_POINTER_DIRECTIVE " %c0\n\t.popsection" :: "i"(&site))
+#else
+#define LITEST_INTERNAL_REGISTER_SITE(site)
+#endif
+
+/**
+ *Internal* The litest::internal::Site of the assertion where this macro is expanded.
+ A constant-initialized static object local to a lambda, so each expansion has its own.
+ @param exprstr String representation of the assertion's expression.
+ */
+#define LITEST_INTERNAL_SITE(exprstr)\
+	([]() -> litest::internal::Site& {\
+		static litest::internal::Site litest_site(__FILE__, __LINE__, exprstr);\
+		LITEST_INTERNAL_REGISTER_SITE(litest_site);\
+		return litest_site;\
+	}())
+
+/**
+ *Internal* The line where this macro is expanded, to record where a test is defined. The line is also recorded
+ as a site without an expression, so that the lines of all tests are known before they are added.
+ */
+#define LITEST_INTERNAL_TEST_LINE LITEST_INTERNAL_SITE(nullptr).line
+
 /**
  *Internal* Assert that an expression evanluates to `true`.
  @param expr Expression to be compared to `true`. Must be convertible to `bool`.
  @param onFail Action to take if the assertion fails.
  */
-#define LITEST_INTERNAL_CHECK(expr, onFail)\
-	static_assert(std::is_convertible<decltype(expr),bool>::value,"Expression is not convertible to bool");\
-	litest::check(LITEST_CONTEXT_ARG, [&] { return (expr); }, onFail, #expr, __LINE__)
+#define LITEST_INTERNAL_CHECK(expr, onFail) LITEST_INTERNAL_CHECK_AT(expr, onFail, &LITEST_INTERNAL_SITE(#expr))
+
+/**
+ *Internal* Assert that an expression evanluates to `true`, counted at a given site.
+ @param expr Expression to be compared to `true`. Must be convertible to `bool`.
+ @param onFail Action to take if the assertion fails.
+ @param site Pointer to the litest::internal::Site of the assertion.
+ */
+#define LITEST_INTERNAL_CHECK_AT(expr, onFail, site)\
+	litest::checkExpression(LITEST_CONTEXT_ARG, [&] {\
+		static_assert(std::is_convertible<decltype(expr),bool>::value,"Expression is not convertible to bool");\
+		LITEST_INTERNAL_SUPPRESS_PARENTHESES_WARNING\
+		return litest::internal::evaluate(litest::internal::Decomposer() <= expr);\
+		LITEST_INTERNAL_RESTORE_WARNINGS\
+	}, onFail, #expr, __LINE__, site)
+
+/**
+ *Internal* Assert that an expression evanluates to `true`, evaluating it only for a deterministic sample of the times it is reached.
+ @param expr Expression to be compared to `true`. Must be convertible to `bool`.
+ @param rate Evaluate about 1 in `rate` times.
+ @param adaptive Start exhaustively and approach `rate` gradually, returning to exhaustive after a failure.
+ @param onFail Action to take if the assertion fails.
+ */
+#define LITEST_INTERNAL_CHECK_SAMPLED(expr, rate, adaptive, onFail)\
+	[&] (litest::internal::Site &litest_sampled_site) {\
+		return LITEST_CONTEXT_ARG.sample(litest_sampled_site, rate, adaptive)\
+			? LITEST_INTERNAL_CHECK_AT(expr, onFail, &litest_sampled_site) : litest::AssertionResult::Skipped;\
+	}(LITEST_INTERNAL_SITE(#expr))
+
+/**
+ *Internal* Assert that an expression becomes `true` within a timeout, polling it with exponential backoff.
+ @param expr Expression to be compared to `true`. Must be convertible to `bool`.
+ @param timeout Maximum time to wait, as a `std::chrono` duration.
+ @param onFail Action to take if the assertion fails.
+ */
+#define LITEST_INTERNAL_EVENTUALLY(expr, timeout, onFail)\
+	litest::eventually(LITEST_CONTEXT_ARG, [&] {\
+		static_assert(std::is_convertible<decltype(expr),bool>::value,"Expression is not convertible to bool");\
+		LITEST_INTERNAL_SUPPRESS_PARENTHESES_WARNING\
+		return litest::internal::evaluate(litest::internal::Decomposer() <= expr);\
+		LITEST_INTERNAL_RESTORE_WARNINGS\
+	}, timeout, onFail, #expr, __LINE__, &LITEST_INTERNAL_SITE(#expr))
 
 /**
  *Internal* Assert that an expression evalutates to a particular value.
@@ -71,8 +292,10 @@
  @param onFail Action to take if the assertion fails.
  */
 #define LITEST_INTERNAL_EQUAL(expr, val, onFail)\
-	static_assert(std::is_convertible<std::remove_reference<decltype(expr)>::type, decltype(val)>::value,"Right argument is not convertible to left argument's type");\
-	litest::equal<std::remove_cv<decltype(val)>::type>(LITEST_CONTEXT_ARG, val, [&] { return (decltype(val))(expr); }, onFail, #expr, __LINE__)
+	litest::equal<std::remove_cv<decltype(val)>::type>(LITEST_CONTEXT_ARG, val, [&] {\
+		static_assert(std::is_convertible<std::remove_reference<decltype(expr)>::type, decltype(val)>::value,"Right argument is not convertible to left argument's type");\
+		return (decltype(val))(expr);\
+	}, onFail, #expr, __LINE__, &LITEST_INTERNAL_SITE(#expr))
 
 /**
  *Internal* Assert that an expression throws.
@@ -80,7 +303,7 @@
  @param onFail Action to take if the assertion fails.
  */
 #define LITEST_INTERNAL_THROWS(expr, onFail)\
-	litest::throws(LITEST_CONTEXT_ARG, [&] { (void)(expr); }, onFail, #expr, __LINE__)
+	litest::throws(LITEST_CONTEXT_ARG, [&] { (void)(expr); }, onFail, #expr, __LINE__, &LITEST_INTERNAL_SITE(#expr))
 
 /**
  *Internal* Assert that an expression throws a particular type.
@@ -107,7 +330,60 @@
  @param name Name of the test (std::string).
  @param block Test body; a compound statement.
  */
-#define LT_ADD_TEST(suite, name, block) suite.addTest(name, [&] (LITEST_ARGS) block, __FILE__)
+#define LT_ADD_TEST(suite, name, block) suite.addTest(name, [&] (LITEST_ARGS) block, __FILE__, LITEST_INTERNAL_TEST_LINE)
+
+#ifdef LITEST_COROUTINES
+/**
+ Add an async test to a test suite. The block is a coroutine that can `co_await` litest::async::readable(),
+ litest::async::writable(), litest::async::sleepFor(), litest::async::ready() and other litest::async::Task s.
+ Consecutive async tests run interleaved on an event loop. Requires C++20 on Linux.
+ @param suite Suite to add the test to.
+ @param name Name of the test (string).
+ @param block The test body (in braces).
+ */
+#define LT_ADD_ASYNC_TEST(suite, name, block) suite.addAsyncTest(name, [&] (LITEST_ARGS) -> litest::async::Task block, __FILE__, LITEST_INTERNAL_TEST_LINE)
+#endif
+
+/** Version of the C interface of test modules; see LT_MODULE. Changes only when the interface breaks. */
+#define LITEST_MODULE_ABI_VERSION 1
+
+/** Marks the entry points of a test module as exported. */
+#define LITEST_MODULE_EXPORT extern "C" __attribute__((visibility("default")))
+
+/**
+ Define a test module: a shared object with one TestSuite, loaded by `litest-server` and `litest-modules`.
+ Followed by a function body that adds tests to `suite`, which is run once, when the module is first used.
+ State kept in static variables of the module, such as expensive fixtures, lives as long as the module is loaded.
+ The module exports its tests through a C interface, so it can be loaded by a runner built separately:
+ 
+ - `unsigned litest_module_abi_version()` returns LITEST_MODULE_ABI_VERSION.
+ - `const char *litest_module_name()` returns the name of the suite.
+ - `int litest_module_test_count()` returns the number of tests.
+ - `int litest_module_test_info(int index, litest::ModuleTestInfo *info)` describes a test.
+ - `int litest_module_run_test(int index, int fd, litest::ModuleTestResult *result)` runs a test.
+ - `int litest_module_run(const char *filter, int fd)` runs the selected tests as one suite.
+ 
+ @param name Name of the TestSuite (string).
+ */
+#define LT_MODULE(name) \
+	static void litestModuleSetup(litest::TestSuite &suite); \
+	static litest::TestSuite &litestModuleSuite() \
+	{ \
+		static litest::TestSuite suite(name); \
+		static bool ready = (litestModuleSetup(suite), true); \
+		(void)ready; \
+		return suite; \
+	} \
+	LITEST_MODULE_EXPORT unsigned litest_module_abi_version() { return LITEST_MODULE_ABI_VERSION; } \
+	LITEST_MODULE_EXPORT const char *litest_module_name() { return litestModuleSuite().suiteName.c_str(); } \
+	LITEST_MODULE_EXPORT int litest_module_test_count() { return (int)litestModuleSuite().tests.size(); } \
+	LITEST_MODULE_EXPORT int litest_module_test_info(int index, litest::ModuleTestInfo *info) \
+	{ return litest::internal::moduleTestInfo(litestModuleSuite(), index, info); } \
+	LITEST_MODULE_EXPORT int litest_module_run_test(int index, int fd, litest::ModuleTestResult *result) \
+	{ return litest::internal::runModuleTest(litestModuleSuite(), index, fd, result); } \
+	LITEST_MODULE_EXPORT int litest_module_run(const char *filter, int fd) \
+	{ return litest::internal::runModule(litestModuleSuite(), filter, fd); } \
+	static void litestModuleSetup(litest::TestSuite &suite)
 
 /**
  Assert that an expression evaluates to `true`. Test will **resume** on failure.
@@ -121,6 +397,59 @@
  */
 #define LT_REQUIRE(expr) LITEST_INTERNAL_CHECK(expr, litest::OnAssertionFailure::Abort)
 
+/**
+ Assert that an expression evaluates to `true`, but only evaluate it for about 1 in `rate` times it is reached.
+ Which times is decided by a deterministic pseudo-random sequence per assertion. Test will **resume** on failure.
+ @param expr Expression to evaluate.
+ @param rate Sampling rate; 1 evaluates every time.
+ */
+#define LT_CHECK_SAMPLED(expr, rate) LITEST_INTERNAL_CHECK_SAMPLED(expr, rate, false, litest::OnAssertionFailure::Continue)
+
+/**
+ Assert that an expression evaluates to `true`, sampling adaptively: every time at first, then less and less often
+ down to about 1 in `maxRate` times. A failure makes the assertion exhaustive again. Test will **resume** on failure.
+ @param expr Expression to evaluate.
+ @param maxRate Lowest sampling rate.
+ */
+#define LT_CHECK_ADAPTIVE(expr, maxRate) LITEST_INTERNAL_CHECK_SAMPLED(expr, maxRate, true, litest::OnAssertionFailure::Continue)
+
+/**
+ Get test input data from the on-disk cache, or generate it and cache it for later runs.
+ The cache is keyed by `key`, the source text of `generator` and the version of the test binary.
+ Usable anywhere, not only in tests.
+ @param key Name of the input (string).
+ @param generator Expression returning a `std::vector` of trivially copyable elements; only evaluated on a cache miss.
+ @return litest::CachedInput holding the data, mapped from the cache file on a hit.
+ */
+#define LT_CACHED_INPUT(key, generator) litest::cachedInput(key, #generator, [&] { return generator; })
+
+/**
+ Assert that an expression becomes `true` within a timeout. The expression is polled with exponential backoff,
+ starting at a microsecond; litest::wakeWaiters() makes it poll again at once. On timeout, the last evaluation
+ is reported like a failed LT_CHECK. Test will **resume** on failure.
+ @param expr Expression to evaluate.
+ @param timeout Maximum time to wait, as a `std::chrono` duration.
+ */
+#define LT_EVENTUALLY(expr, timeout) LITEST_INTERNAL_EVENTUALLY(expr, timeout, litest::OnAssertionFailure::Continue)
+
+/**
+ Assert that an expression becomes `true` within a timeout; see LT_EVENTUALLY. Test will **abort** on failure.
+ @param expr Expression to evaluate.
+ @param timeout Maximum time to wait, as a `std::chrono` duration.
+ */
+#define LT_EVENTUALLY_REQ(expr, timeout) LITEST_INTERNAL_EVENTUALLY(expr, timeout, litest::OnAssertionFailure::Abort)
+
+/**
+ Assert that a block of code makes no system calls, e.g. a real-time path after its warmup. The block runs in a
+ forked child process under a seccomp filter that traps every system call; trapped calls fail with `ENOSYS`, and
+ are reported by number. An allocation that needs memory from the kernel fails, so the block may throw or crash
+ after a call; that is reported too. A block that runs for more than 10 seconds is killed. Changes the block
+ makes, and its assertions, do not reach the test. Only available on Linux on x86-64 and AArch64.
+ Test will **resume** on failure.
+ @param block Code to run; a compound statement.
+ */
+#define LT_NO_SYSCALLS(block) litest::noSyscalls(LITEST_CONTEXT_ARG, [&] block, __LINE__, &LITEST_INTERNAL_SITE("no system calls"))
+
 /**
  Assert that an expression evaluates to a certain value. Test will **resume** on failure.
  @param expr Expression to evaluate.
@@ -153,7 +482,7 @@
  @param type Type of instance thrown.
  */
 #define LT_EXCEPT(expr, type)\
-	litest::throwsType<type>(LITEST_CONTEXT_ARG, [&] { (void)(expr); }, litest::OnAssertionFailure::Continue, #expr, __LINE__)
+	litest::throwsType<type>(LITEST_CONTEXT_ARG, [&] { (void)(expr); }, litest::OnAssertionFailure::Continue, #expr, __LINE__, &LITEST_INTERNAL_SITE(#expr))
 
 /**
  Assert that an expression will lead to a `throw` of a particular type. Test will **abort** on failure.
@@ -161,19 +490,19 @@
  @param type Type of instance thrown.
  */
 #define LT_EXCEPT_REQ(expr, type)\
-	litest::throwsType<type>(LITEST_CONTEXT_ARG, [&] { (void)(expr); }, litest::OnAssertionFailure::Abort, #expr, __LINE__)
+	litest::throwsType<type>(LITEST_CONTEXT_ARG, [&] { (void)(expr); }, litest::OnAssertionFailure::Abort, #expr, __LINE__, &LITEST_INTERNAL_SITE(#expr))
 
 /**
  Manually generate an assertion failure during a test. Test will **resume** afterwards.
  @param reason Explanation for the failure (std::string).
  */
-#define LT_FAIL(reason) litest::generateFailure(LITEST_CONTEXT_ARG, reason, litest::OnAssertionFailure::Continue, __LINE__)
+#define LT_FAIL(reason) litest::generateFailure(LITEST_CONTEXT_ARG, reason, litest::OnAssertionFailure::Continue, __LINE__, &LITEST_INTERNAL_SITE(#reason))
 
 /**
  Manually generate an assertion failure during a test. Test will **abort** afterwards.
  @param reason Explanation for the failure (std::string).
  */
-#define LT_ABORT(reason) litest::generateFailure(LITEST_CONTEXT_ARG, reason, litest::OnAssertionFailure::Abort, __LINE__)
+#define LT_ABORT(reason) litest::generateFailure(LITEST_CONTEXT_ARG, reason, litest::OnAssertionFailure::Abort, __LINE__, &LITEST_INTERNAL_SITE(#reason))
 
 /**
  Generate a message during a test.
@@ -187,6 +516,23 @@
  */
 #define LT_PRINT_EXPR(expr) LITEST_CONTEXT_ARG.output->formatExpr(__LINE__, #expr, litest::internal::descriptionIfAvailable(expr))
 
+/**
+ Measure the running time of a statement block during a test.
+ The machine is inspected for conditions that make benchmarks unreliable before the first benchmark of a run.
+ @param name Name of the benchmark (std::string).
+ @param block Code to measure; a compound statement.
+ */
+#define LT_BENCHMARK(name, block) litest::benchmark(LITEST_CONTEXT_ARG, name, [&] block, __LINE__)
+
+/**
+ Run a benchmark for each combination of working-set size and stride, on a litest::bench::Buffer per size.
+ @param name Name of the benchmark series (std::string).
+ @param sizes Working-set sizes in bytes (std::vector<size_t>).
+ @param strides Strides in bytes (std::vector<size_t>).
+ @param func Function object taking (litest::bench::Buffer &, size_t size, size_t stride).
+ */
+#define LT_BENCHMARK_SWEEP(name, sizes, strides, func) litest::bench::sweep(LITEST_CONTEXT_ARG, name, sizes, strides, func, __LINE__)
+
 /**@}*/
 
 /**
@@ -199,7 +545,8 @@ namespace litest
 	enum class AssertionResult
 	{
 		Passed, /**< The assertion was evaluated and checked successfully. */
-		Failed /**< The assertion was not completed successfully. */
+		Failed, /**< The assertion was not completed successfully. */
+		Skipped /**< The assertion was not evaluated, as decided by sampling. */
 	};
 	
 	/** Action to take after an assertion failure. */
@@ -269,13 +616,54 @@ namespace litest
 	struct TestStats
 	{
 		/** Number of passed assertions in the Test. */
-		int passes = 0;
+		long long passes = 0;
 		
 		/** Number of failed assertions in the Test. */
-		int fails = 0;
+		long long fails = 0;
+		
+		/** Number of evaluations of sampled assertions (included in passes and fails). */
+		long long sampled = 0;
+		
+		/** Number of sampled assertions that were skipped. */
+		long long skips = 0;
+		
+		/** Number of aborted tests: 0 or 1 for a Test, the count for a run. */
+		long long aborted = 0;
+		
+		/** Number of tests skipped because a dependency did not pass; see TestSuite::addDependency(). */
+		long long skippedTests = 0;
+		
+		/** Number of tests whose assertions differed between runs; see TestSuite::determinismRuns. */
+		long long nondeterministic = 0;
+	};
+	
+	/** An assertion site and its counters in a run; see TestSuite::assertionSites(). */
+	struct AssertionSite
+	{
+		/** File the assertion is in. */
+		std::string file;
+		
+		/** Line the assertion is on. */
+		int line;
+		
+		/** String representation of the asserted expression. */
+		std::string expr;
+		
+		/** Number of times the assertion was reached, whether evaluated or skipped by sampling. */
+		long long hits;
+		
+		/** Number of times the assertion passed. */
+		long long passes;
+		
+		/** Number of times the assertion failed. */
+		long long fails;
+		
+		/** Estimated time spent evaluating the asserted expression, in nanoseconds. */
+		double nanoseconds;
 	};
 	
 	class TestSuite;
+	class CapturedOutput;
 	
 	/**
 	 Type of a test function object.
@@ -307,6 +695,9 @@ namespace litest
 		/** File name of the file this test was defined in. */
 		std::string file;
 		
+		/** Line this test was defined on, or 0 if unknown. */
+		int line = 0;
+		
 		/** Name of this test. */
 		std::string name;
 		
@@ -324,138 +715,4298 @@ namespace litest
 		 Invalid if aborted is true.
 		 */
 		double duration;
+		
+		/** Standard output and standard error of the last run, if captured; see TestSuite::captureOutput. */
+		std::shared_ptr<CapturedOutput> output;
+		
+		/** Whether this is an async test, whose function spawns a coroutine; see LT_ADD_ASYNC_TEST. */
+		bool async = false;
+		
+		/** Names of the tests that have to pass before this test is worth running; see TestSuite::addDependency(). */
+		std::vector<std::string> dependencies;
 	};
 	
-	// --------------------------
-	// Output formatting
-	// --------------------------
+#pragma mark - CPU Placement
 	
-	/** Namespace for internal LiTest functions. */
-	namespace internal
+	/** Placement of workers on CPU cores and NUMA nodes. */
+	namespace placement
 	{
+		/** A logical CPU and its position in the machine topology. */
+		struct Cpu
+		{
+			/** Logical CPU number, as used by the operating system. */
+			int id;
+			
+			/** Physical core; logical CPUs with the same core and package are SMT siblings. */
+			int core;
+			
+			/** Physical package (socket). */
+			int package;
+			
+			/** NUMA node. */
+			int node;
+		};
+		
 		/**
-		 Generates a 'not available' description for a value (used in a LiTest assertion).
-		 Overload resolution fallback for types used in LiTest assertions that does not
-		 implement any of the overloaded mechanisms for printing values.
-		 @param ... The value to describe. Elipsis parameter used for a weak overload precedence.
-		 @return A string representing 'not available'
+		 Parse a CPU list in the format used by Linux, e.g. `0-3,8,10-11`.
+		 @param list CPU list.
+		 @return CPU numbers in the list.
 		 */
-		std::string descriptionIfAvailable(...)
+		inline std::vector<int> parseCpuList(std::string const& list)
 		{
-			return "N/A";
+			std::vector<int> cpus;
+			std::stringstream ss(list);
+			std::string range;
+			while (std::getline(ss, range, ','))
+			{
+				if (range.empty() || !isdigit((unsigned char)range[0])) continue;
+				size_t dash = range.find('-');
+				int first = std::atoi(range.c_str());
+				int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+				for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+			}
+			return cpus;
 		}
 		
 		/**
-		 Generates a proper description for a value (used in a LiTest assertion).
-		 This overload prints by appyling operator<< with a std::stringstream.
-		 @tparam T Type of the value to describe.
-		 @param val Value to describe.
-		 @return A string description of val.
+		 Format CPU numbers as a CPU list, e.g. `0-3,8`.
+		 @param cpus CPU numbers.
+		 @return CPU list.
 		 */
-		template<typename T>
-		decltype(std::declval<std::stringstream&>() << std::declval<T>(), std::string())
-		descriptionIfAvailable(T &val)
+		inline std::string formatCpuList(std::vector<int> cpus)
 		{
-			std::stringstream vals;
-			vals << val;
-			return vals.str();
+			std::sort(cpus.begin(), cpus.end());
+			std::stringstream ss;
+			for (size_t i = 0; i < cpus.size(); )
+			{
+				size_t j = i;
+				while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+				if (i > 0) ss << ",";
+				ss << cpus[i];
+				if (j > i) ss << "-" << cpus[j];
+				i = j + 1;
+			}
+			return ss.str();
 		}
 		
 		/**
-		 Generates a proper description for a value (used in a LiTest assertion).
-		 For iterable containers, by std::copy():ing the contents of the containter to a std::stringstream with
-		 std::ostream_iterator.
-		 @tparam T Type of the value to describe.
-		 @param val Value to describe.
-		 @return A string description of val.
+		 Read a single integer from a (sysfs) file.
+		 @param path File path.
+		 @param fallback Value returned if the file can not be read.
+		 @return The value.
 		 */
-		template<typename T>
-		decltype(begin(std::declval<T>()), std::string())
-		descriptionIfAvailable(T const& val)
+		inline int readInt(std::string const& path, int fallback)
 		{
-			std::stringstream vals;
-			std::copy(begin(val), end(val), std::ostream_iterator<typename T::value_type> { vals, ", " });
-			return "{ " + vals.str() + " }";
+			std::ifstream in(path);
+			int value;
+			return (in >> value) ? value : fallback;
 		}
-	}
-	
-	/**
-	 Astract class for formatting of test result output.
-	 
-	 A class to be overridden, not instanced.
-	 Derived classes implement a specific output format; this root class
-	 provies stubs of virtual member functions for the stages in the test life cycle
-	 (like formatTestHeader()) and for test events (like formatPassedCheck()).
-	 */
-	class TestResultFormatter
-	{
-	public:
 		
 		/**
-		 Constructor.
-		 @param ostr Output stream to be used by this instance.
+		 Get the CPUs this process may run on, ordered so that SMT siblings, cores of the same package
+		 and packages of the same NUMA node are adjacent.
+		 @return Ordered list of usable logical CPUs.
 		 */
-		TestResultFormatter(std::ostream &ostr)
-		: s(ostr)
-		{}
+		inline std::vector<Cpu> topology()
+		{
+			std::vector<Cpu> cpus;
+#ifdef __linux__
+			cpu_set_t mask;
+			CPU_ZERO(&mask);
+			if (sched_getaffinity(0, sizeof mask, &mask) == 0)
+			{
+				std::map<int, int> nodeOf;
+				if (DIR *dir = opendir("/sys/devices/system/node"))
+				{
+					while (dirent *entry = readdir(dir))
+					{
+						std::string name = entry->d_name;
+						if (name.compare(0, 4, "node") != 0 || name.size() < 5 || !isdigit((unsigned char)name[4])) continue;
+						std::ifstream in("/sys/devices/system/node/" + name + "/cpulist");
+						std::string list;
+						std::getline(in, list);
+						for (int cpu : parseCpuList(list)) nodeOf[cpu] = std::atoi(name.c_str() + 4);
+					}
+					closedir(dir);
+				}
+				
+				for (int id = 0; id < CPU_SETSIZE; ++id)
+				{
+					if (!CPU_ISSET(id, &mask)) continue;
+					std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+					Cpu cpu;
+					cpu.id = id;
+					cpu.core = readInt(base + "core_id", id);
+					cpu.package = readInt(base + "physical_package_id", 0);
+					cpu.node = nodeOf.count(id) ? nodeOf[id] : 0;
+					cpus.push_back(cpu);
+				}
+			}
+#endif
+			if (cpus.empty())
+				for (int id = 0; id < (int)std::max(1u, std::thread::hardware_concurrency()); ++id)
+					cpus.push_back({ id, id, 0, 0 });
+			
+			std::stable_sort(cpus.begin(), cpus.end(), [] (Cpu const& a, Cpu const& b)
+			{
+				if (a.node != b.node) return a.node < b.node;
+				if (a.package != b.package) return a.package < b.package;
+				if (a.core != b.core) return a.core < b.core;
+				return a.id < b.id;
+			});
+			return cpus;
+		}
 		
 		/**
-		 Pure virtual destructor.
-		 Ensures that TestResultFormatter is an abstract class.
+		 Restrict the calling thread (and threads and processes it creates later) to a set of CPUs.
+		 @param cpus CPU numbers.
+		 @return `true` on success; always `false` where unsupported.
 		 */
-		virtual ~TestResultFormatter() = 0;
-		
-		// For entire tests
-		
-		/**@{*/
-		/** @name Test lifecycle functions */
+		inline bool pinCurrentThread(std::vector<int> const& cpus)
+		{
+#ifdef __linux__
+			if (cpus.empty()) return false;
+			cpu_set_t mask;
+			CPU_ZERO(&mask);
+			for (int cpu : cpus) if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &mask);
+			return sched_setaffinity(0, sizeof mask, &mask) == 0;
+#else
+			return false;
+#endif
+		}
 		
-		/**
-		 Called at the start of a test run with information about the test.
-		 Does nothing unless overridden.
-		 @param test Test to be run.
-		 */
-		virtual void formatTestHeader(Test const& test) {}
+		/** Pins the calling thread to a set of CPUs for its lifetime, then restores the previous affinity. */
+		class ScopedPin
+		{
+		public:
+			
+			/**
+			 Constructor.
+			 @param cpus CPU numbers; nothing is done if empty.
+			 */
+			explicit ScopedPin(std::vector<int> const& cpus)
+			{
+#ifdef __linux__
+				CPU_ZERO(&this->previous_);
+				this->active_ = !cpus.empty() && sched_getaffinity(0, sizeof this->previous_, &this->previous_) == 0 && pinCurrentThread(cpus);
+#endif
+			}
+			
+			/** Destructor. Restores the previous affinity. */
+			~ScopedPin()
+			{
+#ifdef __linux__
+				if (this->active_) sched_setaffinity(0, sizeof this->previous_, &this->previous_);
+#endif
+			}
+			
+			ScopedPin(ScopedPin const&) = delete;
+			ScopedPin& operator=(ScopedPin const&) = delete;
+			
+		private:
+			
+			/** Whether the thread was pinned. */
+			bool active_ = false;
+#ifdef __linux__
+			/** Affinity before pinning. */
+			cpu_set_t previous_;
+#endif
+		};
 		
 		/**
-		 Called at the end of a test run with statistics from the run.
-		 Does nothing unless overridden.
-		 @param test The running test.
-		 @param stats TestStats from the current test run.
+		 Make the calling thread allocate memory on the NUMA node of the CPU it runs on.
+		 The policy is inherited by threads and processes it creates later.
+		 @return `true` on success; always `false` where unsupported.
 		 */
-		virtual void formatTestFooter(Test const& test, TestStats stats) {}
+		inline bool preferLocalMemory()
+		{
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+			const int MPOL_LOCAL_ = 4; // MPOL_LOCAL in <numaif.h>, which is not always installed
+			return syscall(SYS_set_mempolicy, MPOL_LOCAL_, nullptr, 0) == 0;
+#else
+			return false;
+#endif
+		}
 		
 		/**
-		 Called when a test is aborted.
-		 Does nothing unless overridden.
-		 @param line The source line number where the test was aborted.
-		 @param reason Reason for the abortion.
+		 The CPUs this process was placed on by litest-run.
+		 @return CPU numbers from the LITEST_CPUS_ENV environment variable, or an empty list.
 		 */
-		virtual void formatAbortedTest(int line, std::string reason) {}
+		inline std::vector<int> assignedCpus()
+		{
+			const char *env = std::getenv(LITEST_CPUS_ENV);
+			return env ? parseCpuList(env) : std::vector<int>();
+		}
 		
-		/**
-		 Called when an entire TestSuite starts to run.
-		 Does nothing unless overridden.
-		 @param suite Current test suite.
-		 */
-		virtual void formatTestSuiteStart(TestSuite const& suite) {}
+		/** CPUs handed out by a CpuAllocator. */
+		struct Allocation
+		{
+			/** CPUs the worker should be pinned to. */
+			std::vector<int> cpus;
+			
+			/** Positions in the topology taken by this allocation, including reserved SMT siblings. */
+			std::vector<size_t> taken;
+			
+			/**
+			 Whether the allocation succeeded.
+			 @return `true` if CPUs were handed out.
+			 */
+			explicit operator bool() const { return !this->cpus.empty(); }
+		};
 		
 		/**
-		 Called at the end of a test suite.
-		 Does nothing unless overridden.
-		 @param suite Current test suite.
+		 Hands out disjoint, contiguous sets of CPUs to workers.
+		 
+		 Sets are taken from a single NUMA node when possible. Exclusive sets (for benchmarks) consist
+		 of whole physical cores, so that no other worker runs on an SMT sibling of a benchmark CPU.
 		 */
-		virtual void formatTestSuiteEnd(TestSuite const& suite) {}
-		
-		/**@}*/
-		/**@{*/
-		/** @name Test event functions */
-		
-		/**
-		 Called when a check assertion passed.
-		 Does nothing unless overridden.
-		 @param line Line number where the assertion was defined.
-		 @param expr String representation of the expression in the assertion.
+		class CpuAllocator
+		{
+		public:
+			
+			/**
+			 Constructor.
+			 @param cpus @optional Topology to allocate from.
+			 */
+			explicit CpuAllocator(std::vector<Cpu> cpus = topology())
+			: cpus_(cpus), busy_(cpus.size(), false) {}
+			
+			/**
+			 Number of CPUs managed.
+			 @return Number of logical CPUs.
+			 */
+			inline size_t size() const { return this->cpus_.size(); }
+			
+			/**
+			 Allocate CPUs for a worker.
+			 @param threads Number of threads the worker runs; clamped to what the machine can provide.
+			 @param exclusive Allocate whole physical cores and pin one thread per core.
+			 @return The allocation, which is empty if not enough CPUs are free at the moment.
+			 */
+			inline Allocation allocate(int threads, bool exclusive = false)
+			{
+				// Group positions into units: single logical CPUs, or physical cores when exclusive
+				std::vector<std::vector<size_t>> units;
+				for (size_t i = 0; i < this->cpus_.size(); ++i)
+				{
+					if (exclusive && i > 0 && sameCore(this->cpus_[i], this->cpus_[i - 1])) units.back().push_back(i);
+					else units.push_back({ i });
+				}
+				size_t want = std::min(std::max(threads, 1), (int)units.size());
+				
+				auto freeUnit = [&] (size_t u)
+				{
+					for (size_t i : units[u]) if (this->busy_[i]) return false;
+					return true;
+				};
+				
+				// First try a window within one NUMA node, then any window
+				for (int pass = 0; pass < 2; ++pass)
+					for (size_t first = 0; first + want <= units.size(); ++first)
+					{
+						bool fits = true;
+						for (size_t u = first; u < first + want && fits; ++u)
+						{
+							fits = freeUnit(u);
+							if (pass == 0) fits = fits && this->cpus_[units[u][0]].node == this->cpus_[units[first][0]].node;
+						}
+						if (!fits) continue;
+						
+						Allocation alloc;
+						for (size_t u = first; u < first + want; ++u)
+						{
+							alloc.cpus.push_back(this->cpus_[units[u][0]].id);
+							if (!exclusive) continue;
+							for (size_t i = 1; i < units[u].size(); ++i) alloc.taken.push_back(units[u][i]);
+						}
+						for (size_t u = first; u < first + want; ++u) alloc.taken.push_back(units[u][0]);
+						for (size_t i : alloc.taken) this->busy_[i] = true;
+						return alloc;
+					}
+				return Allocation();
+			}
+			
+			/**
+			 Return the CPUs of an allocation.
+			 @param alloc Allocation previously returned by allocate().
+			 */
+			inline void release(Allocation const& alloc)
+			{
+				for (size_t i : alloc.taken) this->busy_[i] = false;
+			}
+			
+		private:
+			
+			/** Whether two logical CPUs are SMT siblings. */
+			static inline bool sameCore(Cpu const& a, Cpu const& b)
+			{
+				return a.core == b.core && a.package == b.package && a.node == b.node;
+			}
+			
+			/** Ordered topology. */
+			std::vector<Cpu> cpus_;
+			
+			/** Whether each position in the topology is in use. */
+			std::vector<bool> busy_;
+		};
+	}
+
+	
+#pragma mark - Benchmark Environment
+	
+	/** Benchmarking support. */
+	namespace bench
+	{
+		/**
+		 The conditions a benchmark runs under.
+		 Unknown values are left at their defaults (empty string or -1).
+		 */
+		struct Environment
+		{
+			/** CPU frequency governor of the benchmark CPU, e.g. `performance`. */
+			std::string governor;
+			
+			/** Whether turbo/boost frequencies are enabled. */
+			int turbo = -1;
+			
+			/** Whether simultaneous multithreading is active. */
+			int smt = -1;
+			
+			/** Whether the machine runs on battery power. */
+			int onBattery = -1;
+			
+			/** System load average over the last minute. */
+			double load = -1;
+			
+			/** Number of CPUs available to this process. */
+			int cpus = 0;
+			
+			/** CPU the benchmarks are pinned to, or -1. */
+			int pinnedCpu = -1;
+			
+			/** Other logical CPUs on the physical core of the benchmark CPU, if SMT is active. */
+			std::vector<int> smtSiblings;
+			
+			/** Whether litest-run reserved whole physical cores for this process, SMT siblings included. */
+			bool exclusiveCores = false;
+			
+			/** Whether the test binary was compiled with optimization. */
+			bool optimized = false;
+			
+			/** Conditions that make benchmark results unreliable. */
+			std::vector<std::string> warnings;
+			
+			/**
+			 Whether benchmark results are reliable.
+			 @return `true` if no bad conditions were found.
+			 */
+			inline bool reliable() const { return this->warnings.empty(); }
+			
+			/**
+			 Describe the environment.
+			 @return Comma-separated description of the known conditions.
+			 */
+			inline std::string description() const
+			{
+				std::stringstream ss;
+				ss << (this->optimized ? "optimized build" : "unoptimized build") << ", " << this->cpus << " CPUs";
+				if (this->pinnedCpu >= 0) ss << ", pinned to CPU " << this->pinnedCpu;
+				if (!this->governor.empty()) ss << ", governor " << this->governor;
+				if (this->turbo >= 0) ss << ", turbo " << (this->turbo ? "on" : "off");
+				if (this->smt >= 0) ss << ", SMT " << (this->smt ? "on" : "off");
+				if (this->onBattery >= 0) ss << (this->onBattery ? ", on battery" : ", on AC power");
+				if (this->load >= 0) ss << ", load " << std::fixed << std::setprecision(2) << this->load;
+				return ss.str();
+			}
+		};
+		
+		/**
+		 Read the first line of a (sysfs or procfs) file.
+		 @param path File path.
+		 @return The line, or an empty string if the file can not be read.
+		 */
+		inline std::string readLine(std::string const& path)
+		{
+			std::ifstream in(path);
+			std::string line;
+			std::getline(in, line);
+			return line;
+		}
+		
+		/**
+		 Inspect the machine for conditions that add noise to benchmarks.
+		 Must be inlined into the test binary, where the optimization level is checked.
+		 @return The benchmark environment.
+		 */
+		inline Environment inspectEnvironment()
+		{
+			Environment env;
+#ifdef __OPTIMIZE__
+			env.optimized = true;
+#endif
+			std::vector<int> assigned = placement::assignedCpus();
+			env.cpus = assigned.empty() ? (int)placement::topology().size() : (int)assigned.size();
+			if (!assigned.empty()) env.pinnedCpu = assigned[0];
+			
+#ifdef __linux__
+			int cpu = env.pinnedCpu >= 0 ? env.pinnedCpu : 0;
+			env.governor = readLine("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/scaling_governor");
+			
+			std::string noTurbo = readLine("/sys/devices/system/cpu/intel_pstate/no_turbo");
+			std::string boost = readLine("/sys/devices/system/cpu/cpufreq/boost");
+			if (!noTurbo.empty()) env.turbo = noTurbo != "1";
+			else if (!boost.empty()) env.turbo = boost == "1";
+			
+			std::string smt = readLine("/sys/devices/system/cpu/smt/active");
+			if (!smt.empty()) env.smt = smt == "1";
+			if (env.smt == 1)
+				for (int sibling : placement::parseCpuList(readLine("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list")))
+					if (sibling != cpu) env.smtSiblings.push_back(sibling);
+			const char *exclusive = std::getenv(LITEST_EXCLUSIVE_CORES_ENV);
+			env.exclusiveCores = exclusive && std::string(exclusive) == "1";
+			
+			if (DIR *dir = opendir("/sys/class/power_supply"))
+			{
+				while (dirent *entry = readdir(dir))
+				{
+					std::string base = std::string("/sys/class/power_supply/") + entry->d_name;
+					if (entry->d_name[0] == '.' || readLine(base + "/type") != "Mains") continue;
+					std::string online = readLine(base + "/online");
+					if (online.empty()) continue;
+					env.onBattery = online == "0" && env.onBattery != 0;
+				}
+				closedir(dir);
+			}
+#endif
+#ifdef LITEST_POSIX
+			double load[1];
+			if (getloadavg(load, 1) == 1) env.load = load[0];
+#endif
+			
+			if (!env.optimized) env.warnings.push_back("the test binary was built without optimization");
+			if (!env.governor.empty() && env.governor != "performance")
+				env.warnings.push_back("CPU frequency governor is '" + env.governor + "', not 'performance'");
+			if (env.turbo == 1) env.warnings.push_back("turbo frequencies are enabled");
+			if (env.onBattery == 1) env.warnings.push_back("the machine runs on battery power");
+			if (!env.smtSiblings.empty() && !env.exclusiveCores)
+			{
+				if (env.pinnedCpu >= 0)
+					env.warnings.push_back("CPU " + std::to_string(env.pinnedCpu) + " shares its physical core with SMT sibling CPUs "
+						+ placement::formatCpuList(env.smtSiblings) + ", which other work may run on");
+				else env.warnings.push_back("SMT is active and the benchmarks are not pinned to a reserved physical core");
+			}
+			if (env.load >= 0 && env.load > 0.5 * std::max(1, env.cpus))
+			{
+				std::stringstream ss;
+				ss << "the system is busy (load " << std::fixed << std::setprecision(2) << env.load << " on " << env.cpus << " CPUs)";
+				env.warnings.push_back(ss.str());
+			}
+			return env;
+		}
+		
+		/**
+		 Prevent the compiler from optimizing away a value computed in a benchmark.
+		 @param value The value.
+		 */
+		template<typename T>
+		inline void doNotOptimize(T const& value)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			asm volatile("" : : "r,m"(value) : "memory");
+#else
+			static volatile char sink;
+			sink = *reinterpret_cast<const volatile char*>(&value);
+#endif
+		}
+		
+		/** Huge page policy of a Buffer. */
+		enum class HugePages
+		{
+			None, /**< Regular pages. */
+			Transparent, /**< Ask the kernel for transparent huge pages (madvise). */
+			Explicit /**< Map explicit huge pages (MAP_HUGETLB); falls back to Transparent if none are reserved. */
+		};
+		
+		/** Allocation policies of a Buffer. */
+		struct BufferOptions
+		{
+			/** Alignment of the buffer start, in bytes. Raised to the huge page size when huge pages are used. */
+			size_t alignment = 64;
+			
+			/** Huge page policy. */
+			HugePages hugePages = HugePages::None;
+			
+			/** NUMA node to bind the memory to, or -1 for the default policy. */
+			int node = -1;
+			
+			/** Whether to touch every page up front, so that page faults are not measured. */
+			bool prefault = true;
+		};
+		
+		/**
+		 Memory for benchmarks, allocated with explicit alignment, huge page, NUMA and pre-faulting policies.
+		 The requested policies are applied where the platform allows; hugePages() and node() tell what was obtained.
+		 */
+		class Buffer
+		{
+		public:
+			
+			/** Size of a (2 MiB) huge page. */
+			static constexpr size_t hugePageSize = 2 << 20;
+			
+			/**
+			 Constructor. Allocates the memory.
+			 @param bytes Size of the buffer.
+			 @param options @optional Allocation policies.
+			 @throws std::bad_alloc if no memory could be mapped.
+			 */
+			explicit Buffer(size_t bytes, BufferOptions options = BufferOptions())
+			: size_(bytes), options_(options)
+			{
+				size_t align = std::max<size_t>(options.alignment, sizeof(void*));
+				if (options.hugePages != HugePages::None) align = std::max(align, (size_t)hugePageSize);
+#ifdef LITEST_POSIX
+				size_t page = (size_t)sysconf(_SC_PAGESIZE);
+				bytes = std::max<size_t>(bytes, 1);
+#ifdef MAP_HUGETLB
+				if (options.hugePages == HugePages::Explicit)
+				{
+					this->mappedSize_ = (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+					void *mem = mmap(nullptr, this->mappedSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+					if (mem != MAP_FAILED)
+					{
+						this->mapping_ = this->data_ = mem;
+						this->hugePages_ = HugePages::Explicit;
+					}
+				}
+#endif
+				if (!this->mapping_)
+				{
+					// Over-allocate to align the start, and to cover whole huge pages
+					size_t span = options.hugePages == HugePages::None ? bytes : (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+					this->mappedSize_ = (span + align + page - 1) / page * page;
+					void *mem = mmap(nullptr, this->mappedSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+					if (mem == MAP_FAILED) throw std::bad_alloc();
+					this->mapping_ = mem;
+					this->data_ = reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(mem) + align - 1) / align * align);
+#ifdef MADV_HUGEPAGE
+					if (options.hugePages != HugePages::None && madvise(this->data_, span, MADV_HUGEPAGE) == 0)
+						this->hugePages_ = HugePages::Transparent;
+#endif
+				}
+#if defined(__linux__) && defined(SYS_mbind)
+				if (options.node >= 0 && options.node < 64)
+				{
+					const int MPOL_BIND_ = 2; // MPOL_BIND in <numaif.h>
+					unsigned long mask = 1UL << options.node;
+					size_t span = (bytes + page - 1) / page * page;
+					uintptr_t start = reinterpret_cast<uintptr_t>(this->data_) / page * page;
+					if (syscall(SYS_mbind, start, span, MPOL_BIND_, &mask, 64, 0) == 0) this->node_ = options.node;
+				}
+#endif
+				if (options.prefault)
+					for (size_t offset = 0; offset < bytes; offset += page) static_cast<volatile char*>(this->data_)[offset] = 0;
+#else
+				this->mapping_ = std::malloc(bytes + align);
+				if (!this->mapping_) throw std::bad_alloc();
+				this->data_ = reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(this->mapping_) + align - 1) / align * align);
+				if (options.prefault) std::fill_n(static_cast<char*>(this->data_), bytes, 0);
+#endif
+			}
+			
+			/** Destructor. Releases the memory. */
+			~Buffer()
+			{
+				if (!this->mapping_) return;
+#ifdef LITEST_POSIX
+				munmap(this->mapping_, this->mappedSize_);
+#else
+				std::free(this->mapping_);
+#endif
+			}
+			
+			/** Move constructor. */
+			Buffer(Buffer &&other)
+			: size_(other.size_), options_(other.options_), data_(other.data_), mapping_(other.mapping_),
+			  mappedSize_(other.mappedSize_), hugePages_(other.hugePages_), node_(other.node_)
+			{
+				other.mapping_ = other.data_ = nullptr;
+			}
+			
+			Buffer(Buffer const&) = delete;
+			Buffer& operator=(Buffer const&) = delete;
+			
+			/**
+			 Start of the buffer.
+			 @return Aligned pointer to the memory.
+			 */
+			inline void *data() const { return this->data_; }
+			
+			/**
+			 Start of the buffer as an array of a type.
+			 @tparam T Element type.
+			 @return Typed pointer to the memory.
+			 */
+			template<typename T>
+			inline T *as() const { return static_cast<T*>(this->data_); }
+			
+			/**
+			 Usable size of the buffer.
+			 @return Size in bytes, as requested.
+			 */
+			inline size_t size() const { return this->size_; }
+			
+			/**
+			 The huge page policy in effect.
+			 @return HugePages::None if huge pages were requested but not granted.
+			 */
+			inline HugePages hugePages() const { return this->hugePages_; }
+			
+			/**
+			 The NUMA node the memory is bound to.
+			 @return Node number, or -1 if not bound.
+			 */
+			inline int node() const { return this->node_; }
+			
+			/**
+			 The policies the buffer was requested with.
+			 @return Allocation policies.
+			 */
+			inline BufferOptions const& options() const { return this->options_; }
+			
+		private:
+			
+			/** Requested size. */
+			size_t size_;
+			
+			/** Requested policies. */
+			BufferOptions options_;
+			
+			/** Aligned start. */
+			void *data_ = nullptr;
+			
+			/** Start and size of the underlying allocation. */
+			void *mapping_ = nullptr;
+			size_t mappedSize_ = 0;
+			
+			/** Obtained policies. */
+			HugePages hugePages_ = HugePages::None;
+			int node_ = -1;
+		};
+		
+		/**
+		 Format a size in bytes for reports.
+		 @param bytes Size.
+		 @return E.g. `48 B`, `32 KiB` or `1.5 MiB`.
+		 */
+		inline std::string formatBytes(double bytes)
+		{
+			const char *units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+			int unit = 0;
+			while (bytes >= 1024 && unit < 4) { bytes /= 1024; ++unit; }
+			std::stringstream ss;
+			ss << bytes << " " << units[unit];
+			return ss.str();
+		}
+		
+		/**
+		 Sizes for a working-set or stride sweep: a geometric series from `from` to `to` (inclusive).
+		 @param from First size.
+		 @param to Last size.
+		 @param stepsPerDoubling @optional Number of sizes per doubling, e.g. 2 gives 4K, 6K, 8K, 12K, ...
+		 @return The sizes, rounded to multiples of 64 bytes above 64.
+		 */
+		inline std::vector<size_t> sweepSizes(size_t from, size_t to, int stepsPerDoubling = 1)
+		{
+			std::vector<size_t> sizes;
+			stepsPerDoubling = std::max(1, stepsPerDoubling);
+			for (size_t base = std::max<size_t>(from, 1); base <= to; base *= 2)
+			{
+				for (int step = 0; step < stepsPerDoubling; ++step)
+				{
+					double scaled = base * std::pow(2.0, (double)step / stepsPerDoubling);
+					if (scaled > (double)to || scaled >= (double)SIZE_MAX) break;
+					size_t size = (size_t)scaled;
+					if (size > 64) size = size / 64 * 64;
+					if (size <= to && (sizes.empty() || size > sizes.back())) sizes.push_back(size);
+				}
+				// Doubling again would pass `to`, or overflow near SIZE_MAX
+				if (base > to / 2) break;
+			}
+			return sizes;
+		}
+		
+		/** Result of a benchmark. */
+		struct Result
+		{
+			/** Name of the benchmark. */
+			std::string name;
+			
+			/** Number of times the benchmark block was run per sample. */
+			long long iterations = 0;
+			
+			/** Number of timed samples. */
+			int samples = 0;
+			
+			/** Fastest sample, in nanoseconds per iteration. */
+			double minNs = 0;
+			
+			/** Median sample, in nanoseconds per iteration. */
+			double medianNs = 0;
+			
+			/** Mean of the samples, in nanoseconds per iteration. */
+			double meanNs = 0;
+			
+			/** Whether the result was measured in a reliable Environment. */
+			bool reliable = false;
+			
+			/**
+			 Median time expressed in host-independent units: the number of simple integer operations the
+			 calibrated machine performs in that time. Zero unless the suite was calibrated.
+			 */
+			double referenceOps = 0;
+		};
+		
+		/** Machine characteristics measured at the start of a calibrated run; see TestSuite::calibrate. */
+		struct Calibration
+		{
+			/** CPU model name. */
+			std::string cpuModel;
+			
+			/** Cache sizes in bytes, or 0 if unknown. */
+			long long l1Size = 0, l2Size = 0, llcSize = 0;
+			
+			/** Memory bandwidth of a STREAM-like triad, in GB/s. */
+			double bandwidthGBs = 0;
+			
+			/** Load-to-use latency measured by pointer chasing within each cache level, in nanoseconds. */
+			double l1LatencyNs = 0, l2LatencyNs = 0, llcLatencyNs = 0;
+			
+			/** Single-core throughput of independent integer additions, in operations per nanosecond. */
+			double intOpsPerNs = 0;
+			
+			/** Single-core throughput of independent floating-point multiply-adds, in operations per nanosecond. */
+			double fpOpsPerNs = 0;
+			
+			/** Time taken by the calibration, in seconds. */
+			double duration = 0;
+		};
+		
+		namespace internal
+		{
+			/**
+			 Parse a cache size from sysfs, e.g. `32K`.
+			 @param str Size string.
+			 @return Size in bytes.
+			 */
+			inline long long parseSize(std::string const& str)
+			{
+				long long size = std::atoll(str.c_str());
+				if (str.find('K') != std::string::npos) size <<= 10;
+				else if (str.find('M') != std::string::npos) size <<= 20;
+				return size;
+			}
+			
+			/**
+			 Force a value into a register, so that the compiler can neither fold nor vectorize the computation of it.
+			 @param value The value.
+			 */
+			template<typename T>
+			inline void keepInRegister(T &value)
+			{
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+				if (std::is_floating_point<T>::value) asm volatile("" : "+x"(value));
+				else asm volatile("" : "+r"(value));
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+				if (std::is_floating_point<T>::value) asm volatile("" : "+w"(value));
+				else asm volatile("" : "+r"(value));
+#else
+				doNotOptimize(value);
+#endif
+			}
+			
+			/**
+			 Measure the average latency of a dependent load chain through a buffer.
+			 @param bytes Size of the buffer.
+			 @param steps Number of loads.
+			 @return Nanoseconds per load.
+			 */
+			inline double chaseLatency(long long bytes, long steps)
+			{
+				struct alignas(64) Node { Node *next; };
+				size_t count = std::max<size_t>(2, bytes / sizeof(Node));
+				std::vector<Node> nodes(count);
+				
+				// Sattolo's algorithm gives a single random cycle through all nodes
+				std::vector<size_t> order(count);
+				std::iota(order.begin(), order.end(), 0);
+				std::mt19937_64 gen(42);
+				for (size_t i = count - 1; i > 0; --i) std::swap(order[i], order[std::uniform_int_distribution<size_t>(0, i - 1)(gen)]);
+				for (size_t i = 0; i < count; ++i) nodes[order[i]].next = &nodes[order[(i + 1) % count]];
+				
+				Node *p = &nodes[0];
+				for (size_t i = 0; i < count; ++i) p = p->next;
+				auto start = TimeTypeHiRes::clock::now();
+				for (long i = 0; i < steps; ++i) p = p->next;
+				double ns = std::chrono::duration<double, std::nano>(TimeTypeHiRes::clock::now() - start).count();
+				doNotOptimize(p);
+				return ns / steps;
+			}
+		}
+		
+		/**
+		 Measure the machine.
+		 Takes a fraction of a second; cache sizes are read from the operating system where possible.
+		 @return Calibration results.
+		 */
+		inline Calibration calibrate()
+		{
+			auto calibrationStart = TimeTypeHiRes::clock::now();
+			Calibration cal;
+			cal.l1Size = 32 << 10;
+			cal.l2Size = 256 << 10;
+			bool cachesRead = false;
+			
+#ifdef __linux__
+			{
+				std::ifstream cpuinfo("/proc/cpuinfo");
+				std::string line;
+				while (std::getline(cpuinfo, line))
+					if (line.compare(0, 10, "model name") == 0 || line.compare(0, 9, "Processor") == 0)
+					{
+						size_t colon = line.find(':');
+						if (colon != std::string::npos) cal.cpuModel = line.substr(line.find_first_not_of(' ', colon + 1));
+						break;
+					}
+				
+				for (int index = 0; ; ++index)
+				{
+					std::string base = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+					std::string level = readLine(base + "level");
+					if (level.empty()) break;
+					if (readLine(base + "type") == "Instruction") continue;
+					long long size = internal::parseSize(readLine(base + "size"));
+					cachesRead = true;
+					if (level == "1") cal.l1Size = size;
+					else if (level == "2") cal.l2Size = size;
+					else cal.llcSize = std::max(cal.llcSize, size);
+				}
+			}
+#endif
+			// Without a level 3 cache, the L2 is the last level; without cache information, assume a common size
+			if (cal.llcSize == 0) cal.llcSize = cachesRead ? cal.l2Size : 8 << 20;
+			if (cal.cpuModel.empty()) cal.cpuModel = "unknown";
+			
+			// Latency: a buffer of half of each cache level, so that it fits in that level but not the one above
+			cal.l1LatencyNs = internal::chaseLatency(cal.l1Size / 2, 1 << 20);
+			cal.l2LatencyNs = internal::chaseLatency(std::max(cal.l2Size / 2, cal.l1Size * 2), 1 << 20);
+			cal.llcLatencyNs = internal::chaseLatency(std::min(std::max(cal.llcSize / 2, cal.l2Size * 2), 64LL << 20), 1 << 20);
+			
+			// Bandwidth: STREAM triad on arrays larger than the last level cache (capped to keep the calibration short)
+			{
+				size_t n = std::min<long long>(std::max<long long>(cal.llcSize, 8 << 20), 32 << 20) / sizeof(double);
+				std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+				double best = 0;
+				for (int rep = 0; rep < 5; ++rep)
+				{
+					auto start = TimeTypeHiRes::clock::now();
+					for (size_t i = 0; i < n; ++i) a[i] = b[i] + 3.0 * c[i];
+					double sec = std::chrono::duration<double>(TimeTypeHiRes::clock::now() - start).count();
+					doNotOptimize(a[n / 2]);
+					best = std::max(best, 3.0 * sizeof(double) * n / sec / 1e9);
+				}
+				cal.bandwidthGBs = best;
+			}
+			
+			// Throughput: eight independent dependency chains keep the execution units busy
+			{
+				const long rounds = 1 << 22;
+				uint64_t x[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+				auto start = TimeTypeHiRes::clock::now();
+				for (long i = 0; i < rounds; ++i)
+				{
+					for (int k = 0; k < 8; ++k) { x[k] += (uint64_t)i ^ k; internal::keepInRegister(x[k]); }
+				}
+				double ns = std::chrono::duration<double, std::nano>(TimeTypeHiRes::clock::now() - start).count();
+				for (uint64_t v : x) doNotOptimize(v);
+				cal.intOpsPerNs = 8.0 * 2 * rounds / ns;
+				
+				double f[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+				start = TimeTypeHiRes::clock::now();
+				for (long i = 0; i < rounds; ++i)
+				{
+					for (int k = 0; k < 8; ++k) { f[k] = f[k] * 0.999999 + 1e-7; internal::keepInRegister(f[k]); }
+				}
+				ns = std::chrono::duration<double, std::nano>(TimeTypeHiRes::clock::now() - start).count();
+				for (double v : f) doNotOptimize(v);
+				cal.fpOpsPerNs = 8.0 * 2 * rounds / ns;
+			}
+			
+			cal.duration = std::chrono::duration<double>(TimeTypeHiRes::clock::now() - calibrationStart).count();
+			return cal;
+		}
+	}
+	
+	// --------------------------
+	// Output formatting
+	// --------------------------
+	
+	/** Namespace for internal LiTest functions. */
+	namespace internal
+	{
+		/**
+		 Generates a 'not available' description for a value (used in a LiTest assertion).
+		 Overload resolution fallback for types used in LiTest assertions that does not
+		 implement any of the overloaded mechanisms for printing values.
+		 @param ... The value to describe. Elipsis parameter used for a weak overload precedence.
+		 @return A string representing 'not available'
+		 */
+		std::string descriptionIfAvailable(...)
+		{
+			return "N/A";
+		}
+		
+		/**
+		 Generates a proper description for a value (used in a LiTest assertion).
+		 This overload prints by appyling operator<< with a std::stringstream.
+		 @tparam T Type of the value to describe.
+		 @param val Value to describe.
+		 @return A string description of val.
+		 */
+		template<typename T>
+		decltype(std::declval<std::stringstream&>() << std::declval<T>(), std::string())
+		descriptionIfAvailable(T &val)
+		{
+			std::stringstream vals;
+			vals << val;
+			return vals.str();
+		}
+		
+		/**
+		 Generates a proper description for a value (used in a LiTest assertion).
+		 For iterable containers, by std::copy():ing the contents of the containter to a std::stringstream with
+		 std::ostream_iterator.
+		 @tparam T Type of the value to describe.
+		 @param val Value to describe.
+		 @return A string description of val.
+		 */
+		template<typename T>
+		decltype(begin(std::declval<T>()), std::string())
+		descriptionIfAvailable(T const& val)
+		{
+			std::stringstream vals;
+			std::copy(begin(val), end(val), std::ostream_iterator<typename T::value_type> { vals, ", " });
+			return "{ " + vals.str() + " }";
+		}
+	}
+
+	namespace internal
+	{
+		/**
+		 Describe an operand of a decomposed check.
+		 Operands are held as const references; this prefers printing with operator<< over iterating,
+		 as for the non-const values described in equals assertions.
+		 @param val Value to describe.
+		 @return A string description of val.
+		 */
+		template<typename T>
+		inline std::string describeOperand(T const& val)
+		{
+			return descriptionIfAvailable(const_cast<typename std::remove_const<T>::type &>(val));
+		}
+		
+		/**
+		 Outcome of a decomposed check.
+		 Operand descriptions are only filled in when the check failed.
+		 */
+		struct Evaluation
+		{
+			/** Whether the checked expression was true. */
+			bool passed;
+			
+			/** Operator of a binary comparison, or `nullptr`. */
+			const char *op = nullptr;
+			
+			/** Description of the left (or only) operand; empty if not worth printing. */
+			std::string lhs;
+			
+			/** Description of the right operand of a binary comparison. */
+			std::string rhs;
+			
+			/**
+			 Constructor.
+			 @param result Whether the checked expression was true.
+			 */
+			explicit Evaluation(bool result)
+			: passed(result) {}
+		};
+		
+		/**
+		 A comparison captured by Decomposer, with its result.
+		 @tparam L Type (or reference type) of the left operand.
+		 @tparam R Type (or reference type) of the right operand.
+		 */
+		template<typename L, typename R>
+		struct BinaryExpr
+		{
+			/** Left operand. */
+			L lhs;
+			
+			/** Right operand. */
+			R rhs;
+			
+			/** Operator, as written. */
+			const char *op;
+			
+			/** Result of the comparison. */
+			bool result;
+			
+			/**
+			 Result of the comparison, for use with `&&`, `||` and `?:`.
+			 @return Result.
+			 */
+			explicit operator bool() const { return this->result; }
+		};
+		
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#endif
+		
+/**
+ *Internal* Define the comparison operator `op` on ExprLhs, producing a BinaryExpr.
+ Arithmetic right operands are taken by value (so that bit-fields work), others by reference.
+ */
+#define LITEST_INTERNAL_DECOMPOSE_OP(op)\
+		template<typename R, typename std::enable_if<!std::is_arithmetic<R>::value, int>::type = 0>\
+		inline BinaryExpr<L, R&> operator op(R &rhs) { return { this->lhs, rhs, #op, this->lhs op rhs }; }\
+		template<typename R, typename std::enable_if<!std::is_arithmetic<R>::value, int>::type = 0>\
+		inline BinaryExpr<L, R const&> operator op(R const& rhs) { return { this->lhs, rhs, #op, this->lhs op rhs }; }\
+		template<typename R, typename std::enable_if<std::is_arithmetic<R>::value, int>::type = 0>\
+		inline BinaryExpr<L, R> operator op(R rhs) { return { this->lhs, rhs, #op, this->lhs op rhs }; }
+		
+		/**
+		 The left operand of a checked expression, captured by Decomposer.
+		 @tparam L Type (or reference type) of the operand.
+		 */
+		template<typename L>
+		struct ExprLhs
+		{
+			/** The operand. */
+			L lhs;
+			
+			LITEST_INTERNAL_DECOMPOSE_OP(==)
+			LITEST_INTERNAL_DECOMPOSE_OP(!=)
+			LITEST_INTERNAL_DECOMPOSE_OP(<)
+			LITEST_INTERNAL_DECOMPOSE_OP(<=)
+			LITEST_INTERNAL_DECOMPOSE_OP(>)
+			LITEST_INTERNAL_DECOMPOSE_OP(>=)
+			
+			/**
+			 Bitwise operators bind weaker than comparisons; their result becomes the new left operand.
+			 @param rhs Right operand.
+			 @return Captured result.
+			 */
+			template<typename R>
+			inline ExprLhs<decltype(std::declval<L>() & std::declval<R const&>())> operator&(R const& rhs) { return { this->lhs & rhs }; }
+			
+			/** @copydoc operator&() */
+			template<typename R>
+			inline ExprLhs<decltype(std::declval<L>() | std::declval<R const&>())> operator|(R const& rhs) { return { this->lhs | rhs }; }
+			
+			/** @copydoc operator&() */
+			template<typename R>
+			inline ExprLhs<decltype(std::declval<L>() ^ std::declval<R const&>())> operator^(R const& rhs) { return { this->lhs ^ rhs }; }
+			
+			/**
+			 Truth value of the operand, for use with `&&`, `||` and `?:`.
+			 @return Operand converted to `bool`.
+			 */
+			explicit operator bool() const { return static_cast<bool>(this->lhs); }
+		};
+		
+#undef LITEST_INTERNAL_DECOMPOSE_OP
+		
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+		
+		/**
+		 Captures the left operand of a checked expression.
+		 `Decomposer() <= a < b` is parsed as `(Decomposer() <= a) < b`, since `<=` binds at least as tight as any
+		 comparison; the comparison is then captured by ExprLhs together with its operands.
+		 */
+		struct Decomposer
+		{
+			/** Capture an lvalue operand by reference. */
+			template<typename T, typename std::enable_if<!std::is_arithmetic<T>::value, int>::type = 0>
+			inline ExprLhs<T&> operator<=(T &lhs) const { return { lhs }; }
+			
+			/** Capture an rvalue operand by const reference. */
+			template<typename T, typename std::enable_if<!std::is_arithmetic<T>::value, int>::type = 0>
+			inline ExprLhs<T const&> operator<=(T const& lhs) const { return { lhs }; }
+			
+			/** Capture an arithmetic operand by value. */
+			template<typename T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+			inline ExprLhs<T> operator<=(T lhs) const { return { lhs }; }
+		};
+		
+		/**
+		 Evaluate an expression that could not be decomposed, e.g. one combined with `&&`.
+		 @param value Value of the expression.
+		 @return Evaluation without operands.
+		 */
+		template<typename T>
+		inline Evaluation evaluate(T const& value)
+		{
+			return Evaluation(static_cast<bool>(value));
+		}
+		
+		/**
+		 Evaluate a single captured operand. Its value is described on failure, unless it is a `bool`.
+		 @param expr Captured operand.
+		 @return Evaluation.
+		 */
+		template<typename L>
+		inline Evaluation evaluate(ExprLhs<L> const& expr)
+		{
+			Evaluation eval(static_cast<bool>(expr));
+			if (!eval.passed && !std::is_same<typename std::decay<L>::type, bool>::value) eval.lhs = describeOperand(expr.lhs);
+			return eval;
+		}
+		
+		/**
+		 Evaluate a captured comparison. The operands are described on failure.
+		 @param expr Captured comparison.
+		 @return Evaluation.
+		 */
+		template<typename L, typename R>
+		inline Evaluation evaluate(BinaryExpr<L, R> const& expr)
+		{
+			Evaluation eval(expr.result);
+			if (!eval.passed)
+			{
+				eval.op = expr.op;
+				eval.lhs = describeOperand(expr.lhs);
+				eval.rhs = describeOperand(expr.rhs);
+			}
+			return eval;
+		}
+		
+		/**
+		 Find the top-level occurrence of a comparison operator in the text of an expression.
+		 @param expr Expression text.
+		 @param op Operator.
+		 @return Position of the operator, or std::string::npos.
+		 */
+		inline size_t findOperator(std::string const& expr, std::string const& op)
+		{
+			int depth = 0;
+			char quote = 0;
+			for (size_t i = 0; i < expr.size(); ++i)
+			{
+				char c = expr[i];
+				if (quote) { if (c == '\\') ++i; else if (c == quote) quote = 0; continue; }
+				if (c == '"' || c == '\'') quote = c;
+				else if (c == '(' || c == '[' || c == '{') ++depth;
+				else if (c == ')' || c == ']' || c == '}') --depth;
+				else if (depth == 0 && expr.compare(i, op.size(), op) == 0)
+				{
+					// Skip longer operators sharing characters, like <<, <=, ->, >>= and ==
+					char before = i > 0 ? expr[i - 1] : ' ';
+					char after = i + op.size() < expr.size() ? expr[i + op.size()] : ' ';
+					if (std::string("<>=!-").find(before) != std::string::npos || std::string("<>=").find(after) != std::string::npos) continue;
+					return i;
+				}
+			}
+			return std::string::npos;
+		}
+		
+		/**
+		 Trim surrounding whitespace.
+		 @param str String.
+		 @return Trimmed string.
+		 */
+		inline std::string trim(std::string const& str)
+		{
+			size_t first = str.find_first_not_of(" \t\n");
+			if (first == std::string::npos) return "";
+			return str.substr(first, str.find_last_not_of(" \t\n") - first + 1);
+		}
+		
+		/**
+		 Whether the text of an operand is a literal of its described value, e.g. `5` or `"abc"`.
+		 @param text Operand text.
+		 @param value Operand description.
+		 @return `true` if printing the value adds nothing.
+		 */
+		inline bool isLiteral(std::string const& text, std::string const& value)
+		{
+			return text == value || text == "\"" + value + "\"" || text == "'" + value + "'";
+		}
+		
+		/**
+		 Describe the operand values of a failed check, e.g. `a=7, b=3` for `a < b`.
+		 Operands whose text is their value (literals) are left out.
+		 @param expr Expression text.
+		 @param eval Evaluation of the failed check.
+		 @return Operand values, or an empty string if there is nothing to add.
+		 */
+		inline std::string describeOperands(std::string const& expr, Evaluation const& eval)
+		{
+			std::string lhsText = trim(expr), rhsText;
+			if (eval.op)
+			{
+				size_t pos = findOperator(expr, eval.op);
+				if (pos == std::string::npos) return eval.lhs + " " + eval.op + " " + eval.rhs;
+				lhsText = trim(expr.substr(0, pos));
+				rhsText = trim(expr.substr(pos + std::string(eval.op).size()));
+			}
+			
+			std::string values;
+			if (!eval.lhs.empty() && !isLiteral(lhsText, eval.lhs)) values = lhsText + "=" + eval.lhs;
+			if (eval.op && !isLiteral(rhsText, eval.rhs)) values += (values.empty() ? "" : ", ") + rhsText + "=" + eval.rhs;
+			return values;
+		}
+	}
+	
+	namespace internal
+	{
+		/**
+		 Serial number of the running test, shared by all test suites.
+		 Used by Site to notice that a new test has started.
+		 @return Reference to the serial number.
+		 */
+		inline unsigned long &testSerial()
+		{
+			static unsigned long serial = 0;
+			return serial;
+		}
+		
+		/**
+		 A static assertion site: one expansion of an assertion macro.
+		 Counts evaluations and failures within the running test.
+		 */
+		struct Site
+		{
+			/**
+			 Constructor.
+			 @param f File name.
+			 @param l Line number.
+			 @param e String representation of the expression.
+			 */
+			constexpr Site(const char *f, int l, const char *e)
+			: file(f), line(l), expr(e) {}
+			
+			/** File the assertion is in. */
+			const char *file;
+			
+			/** Line the assertion is on. */
+			int line;
+			
+			/** String representation of the asserted expression. */
+			const char *expr;
+			
+			/** Test the counters below belong to; see testSerial(). */
+			unsigned long serial = 0;
+			
+			/** Number of times the assertion was evaluated in the test. */
+			long long evaluations = 0;
+			
+			/** Number of times the assertion failed in the test. */
+			long long fails = 0;
+			
+			/** Evaluation number of the first failure that was not reported in full. */
+			long long firstSuppressed = 0;
+			
+			/** Number of times a sampled assertion was skipped in the test. */
+			long long skips = 0;
+			
+			/** Number of times the assertion was reached when it last failed; restarts adaptive sampling. */
+			long long adaptiveBase = 0;
+			
+			/** Number of times the assertion was reached since the start of the current test suite run. */
+			long long hits = 0;
+			
+			/** Number of times the assertion passed since the start of the current test suite run. */
+			long long totalPasses = 0;
+			
+			/** Number of times the assertion failed since the start of the current test suite run. */
+			long long totalFails = 0;
+			
+			/** Number of evaluations that were timed; see SiteTimer. */
+			long long timedEvaluations = 0;
+			
+			/** Total time of the timed evaluations, in nanoseconds. */
+			long long timedNanoseconds = 0;
+			
+			/** Whether the site was added to reachedSites(); only used without LITEST_SITE_SECTION. */
+			bool listed = false;
+			
+			/** Count the assertion as reached. */
+			inline void reach();
+			
+			/** Reset the counters of a test suite run. */
+			inline void resetTotals()
+			{
+				this->hits = this->totalPasses = this->totalFails = this->timedEvaluations = this->timedNanoseconds = 0;
+			}
+			
+			/**
+			 Estimate the total time spent evaluating the assertion from the timed evaluations.
+			 @return Estimated time in nanoseconds.
+			 */
+			inline double estimatedNanoseconds() const
+			{
+				if (this->timedEvaluations == 0) return 0;
+				return (double)this->timedNanoseconds / this->timedEvaluations * (this->totalPasses + this->totalFails);
+			}
+			
+			/**
+			 Reset the counters if a new test has started.
+			 @return Whether the counters were reset.
+			 */
+			inline bool enterTest()
+			{
+				if (this->serial == testSerial()) return false;
+				this->serial = testSerial();
+				this->evaluations = this->fails = this->firstSuppressed = this->skips = this->adaptiveBase = 0;
+				return true;
+			}
+			
+			/**
+			 Count an evaluation.
+			 @return Evaluation number within the test, starting at 1.
+			 */
+			inline long long evaluate()
+			{
+				this->enterTest();
+				this->reach();
+				return ++this->evaluations;
+			}
+			
+			/**
+			 Decide whether a sampled assertion is evaluated this time.
+			 The decision is a deterministic function of the site and the number of times it was reached in the test.
+			 @param rate Evaluate about 1 in `rate` times.
+			 @param adaptive Evaluate every time during the first 64 times after the start of the test or the last
+			 failure, and then about 1 in n/64 times when reached n times since, up to `rate`.
+			 @return Whether to evaluate the assertion.
+			 */
+			inline bool sample(long long rate, bool adaptive)
+			{
+				this->enterTest();
+				long long reached = this->evaluations + this->skips;
+				if (adaptive) rate = std::min(rate, (reached - this->adaptiveBase) / 64 + 1);
+				if (rate <= 1) return true;
+				
+				// SplitMix64 of the site and the count
+				uint64_t z = ((uint64_t)this->line << 40) ^ (uint64_t)reached;
+				z += 0x9e3779b97f4a7c15ULL;
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+				z ^= z >> 31;
+				return z % (uint64_t)rate == 0;
+			}
+		};
+		
+		/**
+		 Sites added at runtime when first reached, for builds without LITEST_SITE_SECTION.
+		 @return Reference to the list.
+		 */
+		inline std::vector<Site*> &reachedSites()
+		{
+			static std::vector<Site*> sites;
+			return sites;
+		}
+		
+		inline void Site::reach()
+		{
+			this->hits++;
+#ifndef LITEST_SITE_SECTION
+			if (!this->listed)
+			{
+				this->listed = true;
+				reachedSites().push_back(this);
+			}
+#endif
+		}
+		
+		/**
+		 Measures the evaluation time of an assertion site while in scope.
+		 Only the first and then every 16th time a site is reached is timed, to keep the cost of reading the clock out of hot loops.
+		 */
+		class SiteTimer
+		{
+		public:
+			
+			/**
+			 Constructor. Starts timing if the evaluation is sampled.
+			 @param site Site being evaluated, or `nullptr`.
+			 */
+			SiteTimer(Site *site)
+			: site_(site && site->hits % 16 == 1 ? site : nullptr), outer_(current())
+			{
+				if (this->site_) this->start_ = std::chrono::steady_clock::now();
+				current() = this;
+			}
+			
+			/** Destructor. Adds the elapsed time, less the excluded time, to the site. */
+			~SiteTimer()
+			{
+				current() = this->outer_;
+				if (!this->site_) return;
+				std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - this->start_ - this->excluded_;
+				this->site_->timedEvaluations++;
+				this->site_->timedNanoseconds += std::max<long long>(0, elapsed.count());
+			}
+			
+			SiteTimer(SiteTimer const&) = delete;
+			SiteTimer& operator=(SiteTimer const&) = delete;
+			
+			/**
+			 Leave time out of the innermost evaluation being timed on this thread, such as time spent waiting.
+			 @param duration Time to leave out.
+			 */
+			static inline void exclude(std::chrono::nanoseconds duration)
+			{
+				if (current()) current()->excluded_ += duration;
+			}
+			
+		private:
+			
+			/** The innermost SiteTimer of this thread. */
+			static inline SiteTimer*& current()
+			{
+				static thread_local SiteTimer *timer = nullptr;
+				return timer;
+			}
+			
+			/** Site being timed, or `nullptr`. */
+			Site *site_;
+			
+			/** SiteTimer that was innermost before this one. */
+			SiteTimer *outer_;
+			
+			/** Time the evaluation started. */
+			std::chrono::steady_clock::time_point start_;
+			
+			/** Time left out with exclude(). */
+			std::chrono::nanoseconds excluded_{0};
+		};
+		
+		/**
+		 Call a function object, timing it as an evaluation of an assertion site.
+		 @param site Site being evaluated, or `nullptr`.
+		 @param func Function object evaluating the assertion.
+		 @return Return value of `func`.
+		 */
+		template<typename Func>
+		inline auto timed(Site *site, Func const& func) -> decltype(func())
+		{
+			SiteTimer timer(site);
+			return func();
+		}
+		
+		/**
+		 All assertion sites of the program, whether reached or not, ordered by file and line.
+		 Without LITEST_SITE_SECTION, only the sites reached so far.
+		 @return Pointers to the sites. An inline function or template may contribute one site per instantiation.
+		 */
+		inline std::vector<Site*> allSites()
+		{
+#ifdef LITEST_SITE_SECTION
+			std::vector<Site*> sites;
+			for (void *const *p = __start_litest_sites; p && p != __stop_litest_sites; ++p)
+				if (*p && static_cast<Site*>(*p)->expr) sites.push_back(static_cast<Site*>(*p));
+			// Inline functions emit a record in each translation unit that uses them
+			std::sort(sites.begin(), sites.end());
+			sites.erase(std::unique(sites.begin(), sites.end()), sites.end());
+#else
+			std::vector<Site*> sites = reachedSites();
+#endif
+			std::stable_sort(sites.begin(), sites.end(), [](Site const* a, Site const* b) {
+				int cmp = std::strcmp(a->file, b->file);
+				return cmp != 0 ? cmp < 0 : a->line < b->line;
+			});
+			return sites;
+		}
+		
+		/**
+		 Lines of the tests defined in a file with LT_ADD_TEST or LT_ADD_ASYNC_TEST, whether added yet or not.
+		 Without LITEST_SITE_SECTION, none are known.
+		 @param file The file.
+		 @return The lines, in ascending order.
+		 */
+		inline std::vector<int> testLines(std::string const& file)
+		{
+			std::vector<int> lines;
+#ifdef LITEST_SITE_SECTION
+			for (void *const *p = __start_litest_sites; p && p != __stop_litest_sites; ++p)
+			{
+				Site const *site = static_cast<Site*>(*p);
+				if (site && !site->expr && file == site->file) lines.push_back(site->line);
+			}
+			std::sort(lines.begin(), lines.end());
+			lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+#else
+			(void)file;
+#endif
+			return lines;
+		}
+		
+		/**
+		 Writer for the litest-run pipe protocol.
+		 
+		 If the environment variable named by LITEST_REPORT_FD_ENV holds a file descriptor, results are written to it
+		 as tab-separated lines, one record per line:
+		 
+		 - `S <suite name>` when a TestSuite starts to run,
+		 - `T <index> <passes> <fails> <aborted> <duration> <test name>` when a test ends,
+		 - `E <passes> <fails> <duration>` when the TestSuite ends.
+		 
+		 Otherwise all functions do nothing.
+		 */
+		class ReportPipe
+		{
+		public:
+			
+			/** Constructor. Looks up the report file descriptor in the environment. */
+			ReportPipe()
+			{
+				const char *env = std::getenv(LITEST_REPORT_FD_ENV);
+				if (env && *env) this->fd = std::atoi(env);
+			}
+			
+			/**
+			 Whether results are reported.
+			 @return `true` if a report file descriptor was given.
+			 */
+			inline bool active() const { return this->fd >= 0; }
+			
+			/**
+			 Report the start of a test suite.
+			 @param name Name of the suite.
+			 */
+			inline void suiteStart(std::string const& name)
+			{
+				if (this->active()) this->write("S\t" + field(name) + "\n");
+			}
+			
+			/**
+			 Report the end of a test.
+			 @param test The finished test.
+			 @param passes Number of passed assertions.
+			 @param fails Number of failed assertions.
+			 */
+			inline void testEnd(Test const& test, long long passes, long long fails)
+			{
+				if (!this->active()) return;
+				std::stringstream ss;
+				ss << "T\t" << test.index << "\t" << passes << "\t" << fails << "\t" << test.aborted << "\t"
+					<< (test.aborted ? 0.0 : test.duration) << "\t" << field(test.name) << "\n";
+				this->write(ss.str());
+			}
+			
+			/**
+			 Report the end of a test suite.
+			 @param passes Total number of passed assertions.
+			 @param fails Total number of failed assertions.
+			 @param duration Time taken to run the suite, in seconds.
+			 */
+			inline void suiteEnd(long long passes, long long fails, double duration)
+			{
+				if (!this->active()) return;
+				std::stringstream ss;
+				ss << "E\t" << passes << "\t" << fails << "\t" << duration << "\n";
+				this->write(ss.str());
+			}
+			
+			/**
+			 Make a string safe to use as a protocol field.
+			 @param str Any string.
+			 @return `str` with tabs and line breaks replaced by spaces.
+			 */
+			static inline std::string field(std::string str)
+			{
+				for (char &c : str) if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+				return str;
+			}
+			
+		private:
+			
+			/** Write a complete record. Records are short enough to be written atomically to a pipe. */
+			inline void write(std::string const& record)
+			{
+#ifdef LITEST_POSIX
+				size_t done = 0;
+				while (done < record.size())
+				{
+					ssize_t n = ::write(this->fd, record.data() + done, record.size() - done);
+					if (n < 0 && errno == EINTR) continue;
+					// The reader is gone, e.g. EPIPE: stop reporting
+					if (n <= 0) { this->fd = -1; return; }
+					done += n;
+				}
+#endif
+			}
+			
+			/** File descriptor to write to, or -1. */
+			int fd = -1;
+		};
+	}
+	
+#pragma mark - Output Capture
+	
+	namespace internal
+	{
+		/**
+		 Stream buffer writing to a POSIX file descriptor.
+		 Lets reports be written to a known descriptor, so that captured output can be spliced into them.
+		 */
+		class FdStreamBuf : public std::streambuf
+		{
+		public:
+			
+			/**
+			 Constructor.
+			 @param fd File descriptor to write to.
+			 @param owned Whether to close the descriptor when destroyed.
+			 */
+			FdStreamBuf(int fd, bool owned)
+			: fd_(fd), owned_(owned)
+			{
+				this->setp(this->buffer_, this->buffer_ + sizeof(this->buffer_));
+			}
+			
+			/** Destructor. Writes buffered data, and closes the descriptor if owned. */
+			~FdStreamBuf()
+			{
+				this->sync();
+#ifdef LITEST_POSIX
+				if (this->owned_ && this->fd_ >= 0) ::close(this->fd_);
+#endif
+			}
+			
+			/**
+			 The descriptor written to.
+			 @return File descriptor, or -1 if it could not be opened.
+			 */
+			inline int fd() const { return this->fd_; }
+			
+			/** @return Start of the bytes written to the buffer but not to the descriptor. */
+			inline const char *pendingData() const { return this->pbase(); }
+			
+			/** @return Number of bytes written to the buffer but not to the descriptor. */
+			inline size_t pendingSize() const { return this->pptr() - this->pbase(); }
+			
+		protected:
+			
+			inline int overflow(int c) override
+			{
+				if (this->sync() != 0) return traits_type::eof();
+				if (c != traits_type::eof()) this->sputc((char)c);
+				return traits_type::not_eof(c);
+			}
+			
+			inline int sync() override
+			{
+#ifdef LITEST_POSIX
+				char *p = this->pbase();
+				while (p < this->pptr())
+				{
+					ssize_t n = ::write(this->fd_, p, this->pptr() - p);
+					if (n <= 0) return -1;
+					p += n;
+				}
+#endif
+				this->setp(this->buffer_, this->buffer_ + sizeof(this->buffer_));
+				return 0;
+			}
+			
+		private:
+			
+			/** Descriptor written to. */
+			int fd_;
+			
+			/** Whether the descriptor is closed when destroyed. */
+			bool owned_;
+			
+			/** Write buffer. */
+			char buffer_[8192];
+		};
+		
+		/**
+		 Find the file descriptor a stream writes to.
+		 @param out Any output stream.
+		 @return The descriptor for a ReportFile or the standard streams, otherwise -1.
+		 */
+		inline int streamFd(std::ostream &out)
+		{
+			if (FdStreamBuf *buf = dynamic_cast<FdStreamBuf*>(out.rdbuf())) return buf->fd();
+			if (out.rdbuf() == std::cout.rdbuf()) return 1;
+			if (out.rdbuf() == std::cerr.rdbuf() || out.rdbuf() == std::clog.rdbuf()) return 2;
+			return -1;
+		}
+		
+		/** Defined under Crash Handling. */
+		inline bool reportsResumed();
+	}
+	
+	/**
+	 An output stream to a report file, written directly to its file descriptor.
+	 Output captured from tests is spliced into it by the kernel rather than copied through iostreams.
+	 */
+	class ReportFile : public std::ostream
+	{
+	public:
+		
+		/**
+		 Constructor. Creates or truncates the file. After a crash, the file is appended to instead, if it may
+		 belong to a run up to the crashed one; see TestSuite::crashHandling.
+		 @param path Path of the report file.
+		 */
+		ReportFile(std::string const& path)
+		: std::ostream(nullptr), buf_(openFile(path), true)
+		{
+			this->rdbuf(&this->buf_);
+			if (this->buf_.fd() < 0) this->setstate(std::ios::failbit);
+		}
+		
+	private:
+		
+		/**
+		 Open a file for writing.
+		 @param path Path of the file.
+		 @return File descriptor, or -1.
+		 */
+		static inline int openFile(std::string const& path)
+		{
+#ifdef LITEST_POSIX
+			int flags = internal::reportsResumed() ? O_APPEND : O_TRUNC;
+			return ::open(path.c_str(), O_WRONLY | O_CREAT | flags | O_CLOEXEC, 0644);
+#else
+			return -1;
+#endif
+		}
+		
+		/** Buffer writing to the file. */
+		internal::FdStreamBuf buf_;
+	};
+	
+	/**
+	 Standard output and standard error of a test, captured in one in-memory file so that their order is kept.
+	 Attached to the Test, and passed to TestResultFormatter::formatCapturedOutput().
+	 */
+	class CapturedOutput
+	{
+	public:
+		
+		/**
+		 Constructor.
+		 @param fd Descriptor of the file holding the output; closed when destroyed.
+		 */
+		CapturedOutput(int fd)
+		: fd_(fd) {}
+		
+		CapturedOutput(CapturedOutput const&) = delete;
+		CapturedOutput& operator=(CapturedOutput const&) = delete;
+		
+		/** Destructor. Closes the file. */
+		~CapturedOutput()
+		{
+#ifdef LITEST_POSIX
+			if (this->fd_ >= 0) ::close(this->fd_);
+#endif
+		}
+		
+		/**
+		 Size of the output.
+		 @return Number of bytes.
+		 */
+		inline size_t size() const
+		{
+#ifdef LITEST_POSIX
+			off_t end = ::lseek(this->fd_, 0, SEEK_END);
+			return end > 0 ? (size_t)end : 0;
+#else
+			return 0;
+#endif
+		}
+		
+		/**
+		 Read the output.
+		 @return The captured bytes.
+		 */
+		inline std::string str() const
+		{
+			std::string data(this->size(), '\0');
+#ifdef LITEST_POSIX
+			size_t done = 0;
+			while (done < data.size())
+			{
+				ssize_t n = ::pread(this->fd_, &data[done], data.size() - done, done);
+				if (n <= 0) break;
+				done += n;
+			}
+			data.resize(done);
+#endif
+			return data;
+		}
+		
+		/**
+		 Write the output to a stream.
+		 If the stream writes to a known file descriptor (see ReportFile), the stream is flushed and the output is
+		 spliced into the descriptor with `sendfile()`; otherwise it is copied.
+		 @param out Stream to write to.
+		 */
+		inline void writeTo(std::ostream &out) const
+		{
+			size_t size = this->size();
+			int outFd = internal::streamFd(out);
+#if defined(__linux__)
+			if (outFd >= 0)
+			{
+				out.flush();
+				off_t offset = 0;
+				while ((size_t)offset < size)
+				{
+					ssize_t n = ::sendfile(outFd, this->fd_, &offset, size - offset);
+					if (n <= 0) break;
+				}
+				if ((size_t)offset == size) return;
+				// Not supported between these files; copy the rest
+				out << this->str().substr(offset);
+				return;
+			}
+#endif
+			(void)outFd;
+			out << this->str();
+		}
+		
+	private:
+		
+		/** Descriptor of the file holding the output. */
+		int fd_;
+	};
+	
+	namespace internal
+	{
+		/**
+		 Redirects the standard output and standard error file descriptors of the process to an in-memory file
+		 while in scope. Output written through iostreams, stdio or directly to the descriptors is captured.
+		 */
+		class OutputRedirect
+		{
+		public:
+			
+			/** Constructor. Starts capturing; does nothing if no file could be created. */
+			OutputRedirect()
+			{
+#ifdef LITEST_POSIX
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+				this->fd_ = ::memfd_create("litest-output", MFD_CLOEXEC);
+#else
+				if (FILE *file = std::tmpfile())
+				{
+					this->fd_ = ::fcntl(fileno(file), F_DUPFD_CLOEXEC, 0);
+					std::fclose(file);
+				}
+#endif
+				if (this->fd_ < 0) return;
+				flushAll();
+				this->savedOut_ = ::fcntl(1, F_DUPFD_CLOEXEC, 0);
+				this->savedErr_ = ::fcntl(2, F_DUPFD_CLOEXEC, 0);
+				::dup2(this->fd_, 1);
+				::dup2(this->fd_, 2);
+#endif
+			}
+			
+			/** Destructor. Stops capturing if finish() was not called. */
+			~OutputRedirect()
+			{
+				this->finish();
+			}
+			
+			/**
+			 Stop capturing and restore the standard descriptors.
+			 @return The captured output, or `nullptr` if nothing was captured.
+			 */
+			inline std::shared_ptr<CapturedOutput> finish()
+			{
+				std::shared_ptr<CapturedOutput> captured;
+#ifdef LITEST_POSIX
+				if (this->fd_ < 0) return captured;
+				flushAll();
+				::dup2(this->savedOut_, 1);
+				::dup2(this->savedErr_, 2);
+				::close(this->savedOut_);
+				::close(this->savedErr_);
+				captured.reset(new CapturedOutput(this->fd_));
+				this->fd_ = -1;
+				this->savedOut_ = this->savedErr_ = -1;
+#endif
+				return captured;
+			}
+			
+			/** @return Descriptor of the file output is captured in, or -1. */
+			inline int fd() const { return this->fd_; }
+			
+			/** @return Descriptor of the original standard output while capturing, otherwise -1. */
+			inline int savedOut() const { return this->savedOut_; }
+			
+			/** @return Descriptor of the original standard error while capturing, otherwise -1. */
+			inline int savedErr() const { return this->savedErr_; }
+			
+		private:
+			
+			/** Write buffered output of iostreams and stdio to the descriptors. */
+			static inline void flushAll()
+			{
+				std::cout.flush();
+				std::cerr.flush();
+				std::clog.flush();
+				std::fflush(stdout);
+				std::fflush(stderr);
+			}
+			
+			/** The in-memory file, or -1. */
+			int fd_ = -1;
+			
+			/** Duplicate of the original standard output. */
+			int savedOut_ = -1;
+			
+			/** Duplicate of the original standard error. */
+			int savedErr_ = -1;
+		};
+	}
+	
+#ifdef LITEST_POSIX
+#pragma mark - Crash Handling
+	
+	namespace internal
+	{
+		/** Fatal signals handled by the crash handler. */
+		static const int crashSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+		
+		/** Number of crashSignals. */
+		static const int crashSignalCount = sizeof(crashSignals) / sizeof(crashSignals[0]);
+		
+		/**
+		 State read by the crash handler. All of it is prepared before tests run, so that the handler
+		 only has to read memory and make async-signal-safe system calls.
+		 */
+		struct CrashState
+		{
+			/** Whether to re-execute the binary after a crash. */
+			bool resume = false;
+			
+			/** Serial number of the running TestSuite run; see runSerial(). */
+			int run = 0;
+			
+			/** Whether a test is running. */
+			volatile sig_atomic_t inTest = 0;
+			
+			/** Position of the running test in TestSuite::tests. */
+			int testPosition = -1;
+			
+			/**
+			 Outcomes of the tests before the running one, by position: `p` (passed), `f` (failed) or `s` (skipped).
+			 Carried to the resumed process, so that the tests it skips still satisfy the dependencies of later tests.
+			 */
+			char outcomes[1024] = {0};
+			
+			/** Index (number) of the running test. */
+			int testIndex = 0;
+			
+			/** Name of the running test, truncated. */
+			char testName[256] = {0};
+			
+			/** Line of the last passed assertion with a known site. */
+			volatile int lastLine = 0;
+			
+			/** Total stats of the running suite. */
+			const TestStats *totals = nullptr;
+			
+			/** Stats of the running test. */
+			const TestStats *current = nullptr;
+			
+			/** Descriptor of the report, or -1 if unknown. */
+			int reportFd = -1;
+			
+			/** Buffer of the report stream, whose pending bytes are written out after a crash; or `nullptr`. */
+			FdStreamBuf *reportBuf = nullptr;
+			
+			/** Text that closes the report; see TestResultFormatter::crashEpilogue(). */
+			char epilogue[512] = {0};
+			
+			/** Original standard output while output is captured, or -1. */
+			int savedOut = -1;
+			
+			/** Original standard error while output is captured, or -1. */
+			int savedErr = -1;
+			
+			/** File holding the captured output of the running test, or -1. */
+			int captureFd = -1;
+			
+			/** Command line to re-execute with; `argv[0]` is `nullptr` if unknown. */
+			char *argv[256] = {nullptr};
+			
+			/** Storage of the command line arguments. */
+			char argBuffer[16384];
+			
+			/** Environment to re-execute with; the last used entry is resumeVar. */
+			std::vector<char*> envp;
+			
+			/** Storage of the LITEST_RESUME_ENV variable. */
+			char resumeVar[256 + sizeof(outcomes)];
+			
+			/** Signal handlers replaced by the crash handler. */
+			struct sigaction previous[crashSignalCount];
+			
+			/** Whether the crash handler is installed. */
+			bool installed = false;
+		};
+		
+		/**
+		 The crash handler state.
+		 @return Reference to the state.
+		 */
+		inline CrashState &crashState()
+		{
+			static CrashState state;
+			return state;
+		}
+		
+		/**
+		 Serial number of TestSuite runs in this process, counting from 1.
+		 Identifies the run to resume after re-execution, as the resumed process repeats the same runs.
+		 @return Reference to the serial number.
+		 */
+		inline int &runSerial()
+		{
+			static int serial = 0;
+			return serial;
+		}
+		
+		/** A crash to resume after, from the LITEST_RESUME_ENV variable. */
+		struct ResumePoint
+		{
+			/** Run that crashed, or 0 if not resuming. */
+			int run = 0;
+			
+			/** Position of the crashed test in TestSuite::tests. */
+			int position = -1;
+			
+			/** Fatal signal. */
+			int signal = 0;
+			
+			/** Line of the last passed assertion. */
+			int line = 0;
+			
+			/** Total stats of the run before the crash. */
+			TestStats totals;
+			
+			/** Stats of the crashed test. */
+			TestStats current;
+			
+			/** Outcomes of the tests before the crashed one; see CrashState::outcomes. */
+			std::string outcomes;
+		};
+		
+		/**
+		 The crash this process resumes after, if it was re-executed by the crash handler.
+		 @return The resume point; `run` is 0 if none.
+		 */
+		inline ResumePoint const& resumePoint()
+		{
+			static ResumePoint point = [] {
+				ResumePoint p;
+				const char *env = std::getenv(LITEST_RESUME_ENV);
+				int length = 0;
+				if (env && *env && std::sscanf(env, "%d,%d,%d,%d,%lld,%lld,%lld,%lld%n", &p.run, &p.position, &p.signal, &p.line,
+						&p.totals.passes, &p.totals.fails, &p.current.passes, &p.current.fails, &length) == 8 && env[length] == ',')
+					p.outcomes = env + length + 1;
+				return p;
+			}();
+			return point;
+		}
+		
+		/**
+		 Whether reports opened now continue those of a crashed process, because the run they belong to has not
+		 started yet and may be the crashed one or one before it.
+		 @return Whether to append to report files.
+		 */
+		inline bool reportsResumed()
+		{
+			return runSerial() < resumePoint().run;
+		}
+		
+		/**
+		 Async-signal-safe write of a string.
+		 @param fd File descriptor.
+		 @param str Null-terminated string.
+		 */
+		inline void safeWrite(int fd, const char *str)
+		{
+			size_t len = 0;
+			while (str[len]) len++;
+			while (len > 0)
+			{
+				ssize_t n = ::write(fd, str, len);
+				if (n <= 0) return;
+				str += n;
+				len -= n;
+			}
+		}
+		
+		/**
+		 Async-signal-safe formatting of a number.
+		 @param buf Buffer of at least 24 characters.
+		 @param value Number.
+		 @return `buf`.
+		 */
+		inline char *safeNumber(char *buf, long long value)
+		{
+			char digits[24];
+			int n = 0;
+			unsigned long long v = value < 0 ? -(unsigned long long)value : value;
+			do { digits[n++] = '0' + v % 10; v /= 10; } while (v);
+			int i = 0;
+			if (value < 0) buf[i++] = '-';
+			while (n) buf[i++] = digits[--n];
+			buf[i] = '\0';
+			return buf;
+		}
+		
+		/**
+		 Async-signal-safe append of a string.
+		 @param dst Destination buffer.
+		 @param pos Position to append at; advanced.
+		 @param size Size of the buffer.
+		 @param str String to append.
+		 */
+		inline void safeAppend(char *dst, size_t &pos, size_t size, const char *str)
+		{
+			while (*str && pos + 1 < size) dst[pos++] = *str++;
+			dst[pos] = '\0';
+		}
+		
+		/**
+		 Name of a fatal signal.
+		 @param sig Signal number.
+		 @return Name, e.g. "SIGSEGV".
+		 */
+		inline const char *signalName(int sig)
+		{
+			switch (sig)
+			{
+				case SIGSEGV: return "SIGSEGV";
+				case SIGBUS: return "SIGBUS";
+				case SIGFPE: return "SIGFPE";
+				case SIGILL: return "SIGILL";
+				case SIGABRT: return "SIGABRT";
+				default: return "signal";
+			}
+		}
+		
+		/**
+		 Restore the standard descriptors while output of a test is captured, and copy the output captured so far to
+		 standard error. Async-signal-safe; for a process that is about to end.
+		 */
+		inline void releaseCapturedOutput()
+		{
+			CrashState &c = crashState();
+			if (c.savedOut >= 0) ::dup2(c.savedOut, 1);
+			if (c.savedErr >= 0) ::dup2(c.savedErr, 2);
+			if (c.captureFd >= 0)
+			{
+				char buffer[4096];
+				ssize_t n;
+				for (off_t offset = 0; (n = ::pread(c.captureFd, buffer, sizeof(buffer), offset)) > 0; offset += n)
+					if (::write(2, buffer, n) != n) break;
+			}
+			c.savedOut = c.savedErr = c.captureFd = -1;
+		}
+		
+		/**
+		 Handler of fatal signals. Writes the last words of the crashed test to standard error: the test,
+		 the last passed assertion and a backtrace. Then either re-executes the binary to resume after the
+		 test, or writes the last words and the epilogue to the report and lets the signal kill the process.
+		 @param sig Signal number.
+		 */
+		inline void crashHandler(int sig)
+		{
+			CrashState &c = crashState();
+			char num[24];
+			
+			// Undo output capture, and save what the formatter wrote so far
+			releaseCapturedOutput();
+			if (c.reportBuf && c.reportFd >= 0)
+			{
+				ssize_t written = ::write(c.reportFd, c.reportBuf->pendingData(), c.reportBuf->pendingSize());
+				(void)written;
+			}
+			
+			char words[768];
+			size_t pos = 0;
+			safeAppend(words, pos, sizeof(words), "\n*** LiTest: ");
+			if (c.inTest)
+			{
+				safeAppend(words, pos, sizeof(words), "test ");
+				safeAppend(words, pos, sizeof(words), safeNumber(num, c.testIndex));
+				safeAppend(words, pos, sizeof(words), " (");
+				safeAppend(words, pos, sizeof(words), c.testName);
+				safeAppend(words, pos, sizeof(words), ") ");
+			}
+			safeAppend(words, pos, sizeof(words), "crashed with ");
+			safeAppend(words, pos, sizeof(words), signalName(sig));
+			if (c.inTest && c.lastLine > 0)
+			{
+				safeAppend(words, pos, sizeof(words), ", last passed assertion at line ");
+				safeAppend(words, pos, sizeof(words), safeNumber(num, c.lastLine));
+			}
+			safeAppend(words, pos, sizeof(words), "\n");
+			safeWrite(2, words);
+#if defined(__GLIBC__)
+			void *frames[64];
+			int depth = ::backtrace(frames, 64);
+			::backtrace_symbols_fd(frames, depth, 2);
+#endif
+			
+			if (c.resume && c.inTest && c.argv[0] && c.totals && c.current)
+			{
+				size_t rpos = 0;
+				safeAppend(c.resumeVar, rpos, sizeof(c.resumeVar), LITEST_RESUME_ENV "=");
+				long long fields[] = {c.run, c.testPosition, sig, c.lastLine,
+					c.totals->passes, c.totals->fails, c.current->passes, c.current->fails};
+				for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+				{
+					if (i) safeAppend(c.resumeVar, rpos, sizeof(c.resumeVar), ",");
+					safeAppend(c.resumeVar, rpos, sizeof(c.resumeVar), safeNumber(num, fields[i]));
+				}
+				safeAppend(c.resumeVar, rpos, sizeof(c.resumeVar), ",");
+				safeAppend(c.resumeVar, rpos, sizeof(c.resumeVar), c.outcomes);
+				safeWrite(2, "*** LiTest: resuming after the crashed test\n");
+				sigset_t none;
+				sigemptyset(&none);
+				::sigprocmask(SIG_SETMASK, &none, nullptr);
+				::execve("/proc/self/exe", c.argv, c.envp.data());
+			}
+			
+			if (c.reportFd >= 0)
+			{
+				safeWrite(c.reportFd, words);
+				safeWrite(c.reportFd, c.epilogue);
+			}
+			::signal(sig, SIG_DFL);
+			::raise(sig);
+		}
+		
+		/**
+		 Install the crash handler, on an alternate stack so that stack overflows are handled too.
+		 Prepares the command line and environment to re-execute with.
+		 @param resume Whether to re-execute after a crash.
+		 */
+		inline void installCrashHandler(bool resume)
+		{
+			CrashState &c = crashState();
+#ifdef __linux__
+			c.resume = resume;
+#else
+			// Re-executing needs /proc/self; elsewhere crashes are only reported
+			c.resume = false;
+			(void)resume;
+#endif
+			if (c.installed) return;
+			
+#ifdef __linux__
+			// Command line and environment, for re-executing
+			int fd = ::open("/proc/self/cmdline", O_RDONLY | O_CLOEXEC);
+			ssize_t len = fd >= 0 ? ::read(fd, c.argBuffer, sizeof(c.argBuffer) - 1) : -1;
+			if (fd >= 0) ::close(fd);
+			if (len > 0 && len < (ssize_t)sizeof(c.argBuffer) - 1)
+			{
+				c.argBuffer[len] = '\0';
+				int argc = 0;
+				for (ssize_t i = 0; i < len && argc < 255; i += std::strlen(c.argBuffer + i) + 1) c.argv[argc++] = c.argBuffer + i;
+				c.argv[argc] = nullptr;
+			}
+			const size_t nameLength = std::strlen(LITEST_RESUME_ENV "=");
+			for (char **env = environ; *env; env++)
+				if (std::strncmp(*env, LITEST_RESUME_ENV "=", nameLength) != 0) c.envp.push_back(*env);
+			c.envp.push_back(c.resumeVar);
+			c.envp.push_back(nullptr);
+#endif
+			
+#if defined(__GLIBC__)
+			// Load the unwinder now; it may allocate on first use
+			void *frames[1];
+			::backtrace(frames, 1);
+#endif
+			
+			static char altStack[65536];
+			stack_t stack;
+			stack.ss_sp = altStack;
+			stack.ss_size = sizeof(altStack);
+			stack.ss_flags = 0;
+			::sigaltstack(&stack, nullptr);
+			
+			struct sigaction action;
+			std::memset(&action, 0, sizeof(action));
+			action.sa_handler = crashHandler;
+			sigemptyset(&action.sa_mask);
+			action.sa_flags = SA_ONSTACK | SA_RESETHAND;
+			for (int i = 0; i < crashSignalCount; i++) ::sigaction(crashSignals[i], &action, &c.previous[i]);
+			c.installed = true;
+		}
+		
+		/** Restore the signal handlers replaced by installCrashHandler(). */
+		inline void uninstallCrashHandler()
+		{
+			CrashState &c = crashState();
+			if (!c.installed) return;
+			for (int i = 0; i < crashSignalCount; i++) ::sigaction(crashSignals[i], &c.previous[i], nullptr);
+			c.envp.clear();
+			c.reportBuf = nullptr;
+			c.reportFd = -1;
+			c.inTest = 0;
+			c.installed = false;
+		}
+	}
+	
+#pragma mark - Sanitizer Reports
+	
+	namespace internal
+	{
+		/** Summaries of sanitizer reports made while a test runs, kept in static storage as they arrive inside the sanitizer. */
+		struct SanitizerReports
+		{
+			/** Number of summaries kept per test; further reports are only counted. */
+			static const int capacity = 16;
+			
+			/** Summary lines, e.g. `SUMMARY: AddressSanitizer: heap-buffer-overflow file.cpp:12 in f()`. */
+			char summaries[capacity][256];
+			
+			/** Number of reports since the last take(). */
+			std::atomic<int> count{0};
+			
+			/**
+			 Take the summaries reported since the last call.
+			 @return Summaries, with a note if some were dropped.
+			 */
+			inline std::vector<std::string> take()
+			{
+				std::vector<std::string> result;
+				int n = this->count.exchange(0);
+				for (int i = 0; i < n && i < capacity; i++) result.push_back(this->summaries[i]);
+				if (n > capacity) result.push_back(std::to_string(n - capacity) + " more sanitizer reports");
+				return result;
+			}
+		};
+		
+		/**
+		 The sanitizer reports of the running test.
+		 @return Reference to the reports.
+		 */
+		inline SanitizerReports &sanitizerReports()
+		{
+			static SanitizerReports reports;
+			return reports;
+		}
+		
+		/**
+		 Record a sanitizer report, and tag it with the running test and its last passed assertion.
+		 Called by the sanitizer runtime for every report, in place of printing the summary line.
+		 @param summary Summary line of the report.
+		 */
+		inline void sanitizerReport(const char *summary)
+		{
+			SanitizerReports &reports = sanitizerReports();
+			CrashState const& c = crashState();
+			const int fd = 2;
+			char num[24];
+			safeWrite(fd, summary);
+			safeWrite(fd, "\n");
+			if (c.inTest)
+			{
+				safeWrite(fd, "*** LiTest: in test ");
+				safeWrite(fd, safeNumber(num, c.testIndex));
+				safeWrite(fd, " (");
+				safeWrite(fd, c.testName);
+				safeWrite(fd, ")");
+				if (c.lastLine > 0)
+				{
+					safeWrite(fd, ", last passed assertion at line ");
+					safeWrite(fd, safeNumber(num, c.lastLine));
+				}
+				safeWrite(fd, "\n");
+			}
+			int i = reports.count++;
+			if (i < SanitizerReports::capacity)
+			{
+				size_t pos = 0;
+				safeAppend(reports.summaries[i], pos, sizeof(reports.summaries[i]), summary);
+			}
+		}
+		
+		/**
+		 The TestSuite that is running tests, for the sanitizer death callback.
+		 @return Reference to the suite pointer.
+		 */
+		inline TestSuite *&runningSuite()
+		{
+			static TestSuite *suite = nullptr;
+			return suite;
+		}
+	}
+	
+#endif
+
+#pragma mark - Checkpoints
+	
+	namespace internal
+	{
+		/**
+		 Stream buffer passing everything on to another one, and keeping a copy while recording.
+		 Used to save the part of the report written for each test in a checkpoint journal.
+		 */
+		class RecordingStreamBuf : public std::streambuf
+		{
+		public:
+			
+			/**
+			 Constructor.
+			 @param target Stream buffer to write to.
+			 */
+			RecordingStreamBuf(std::streambuf *target)
+			: target_(target) {}
+			
+			/** Start recording, discarding anything recorded before. */
+			inline void start()
+			{
+				this->recorded_.clear();
+				this->recording_ = true;
+			}
+			
+			/**
+			 Stop recording.
+			 @return What was written since start().
+			 */
+			inline std::string stop()
+			{
+				this->recording_ = false;
+				return std::move(this->recorded_);
+			}
+			
+		protected:
+			
+			inline int overflow(int c) override
+			{
+				if (c == traits_type::eof()) return traits_type::not_eof(c);
+				if (this->recording_) this->recorded_ += (char)c;
+				return this->target_->sputc((char)c);
+			}
+			
+			inline std::streamsize xsputn(const char *data, std::streamsize n) override
+			{
+				if (this->recording_) this->recorded_.append(data, n);
+				return this->target_->sputn(data, n);
+			}
+			
+			inline int sync() override
+			{
+				return this->target_->pubsync();
+			}
+			
+		private:
+			
+			/** Stream buffer written to. */
+			std::streambuf *target_;
+			
+			/** Whether writes are recorded. */
+			bool recording_ = false;
+			
+			/** Recorded text. */
+			std::string recorded_;
+		};
+		
+		/** A completed test, as saved in a checkpoint journal. */
+		struct CheckpointRecord
+		{
+			/** Name of the suite. */
+			std::string suite;
+			
+			/** Run of the suite in the process, counting from 1; see runSerial(). */
+			int run = 0;
+			
+			/** Position of the test in the run. */
+			int position = 0;
+			
+			/** Name of the test. */
+			std::string name;
+			
+			/** "passed" or "failed". */
+			std::string outcome;
+			
+			/** Stats of the test. */
+			TestStats stats;
+			
+			/** Part of the report written for the test. */
+			std::string report;
+			
+			/** Counters the test added to assertion sites. */
+			std::vector<AssertionSite> sites;
+		};
+		
+		/**
+		 Journal of the tests completed by a run, appended to after each test, so that a run that was interrupted
+		 can be resumed without running them again; see TestSuite::checkpointFile.
+		 Records are text headers followed by the strings they give the lengths of, and end with a line of their own,
+		 so that a record torn by the interruption is recognized and dropped.
+		 */
+		class CheckpointJournal
+		{
+		public:
+			
+			/**
+			 Open the journal. Later calls with the same path do nothing, so that all runs in a process share it.
+			 @param path Path of the journal.
+			 @param resume Whether to keep the tests recorded by an interrupted process; otherwise they are removed.
+			 */
+			inline void open(std::string const& path, bool resume)
+			{
+				if (path == this->path_) return;
+				this->path_ = path;
+				this->records_.clear();
+				
+				std::string data;
+				size_t valid = 0;
+				if (resume)
+				{
+					std::ifstream in(path, std::ios::binary);
+					data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+					CheckpointRecord record;
+					while (decode(data, valid, record)) this->records_.push_back(record);
+				}
+				this->out_.close();
+				if (!resume)
+				{
+					this->out_.open(path, std::ios::binary | std::ios::trunc);
+					return;
+				}
+				
+				// The valid records replace the journal at once, so that an interruption now loses none of them
+				if (valid < data.size())
+				{
+					std::string temporary = path + ".tmp";
+					{
+						std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+						out.write(data.data(), valid);
+						out.flush();
+					}
+					std::rename(temporary.c_str(), path.c_str());
+				}
+				this->out_.open(path, std::ios::binary | std::ios::app);
+			}
+			
+			/**
+			 Find a completed test.
+			 @return The record of the test, or `nullptr`.
+			 */
+			inline CheckpointRecord const* find(std::string const& suite, int run, int position, std::string const& name) const
+			{
+				for (CheckpointRecord const& record : this->records_)
+					if (record.run == run && record.position == position && record.name == name && record.suite == suite) return &record;
+				return nullptr;
+			}
+			
+			/**
+			 Save a completed test. The record is written out at once, so it survives the process being killed.
+			 @param record The test.
+			 */
+			inline void append(CheckpointRecord const& record)
+			{
+				this->out_ << encode(record);
+				this->out_.flush();
+			}
+			
+		private:
+			
+			/** Serialize a record. */
+			static inline std::string encode(CheckpointRecord const& record)
+			{
+				std::stringstream ss;
+				ss << std::setprecision(17);
+				ss << "T\t" << record.run << "\t" << record.position << "\t" << record.stats.passes << "\t" << record.stats.fails
+					<< "\t" << record.stats.sampled << "\t" << record.stats.skips << "\t" << record.stats.aborted << "\t" << record.stats.nondeterministic << "\t" << record.sites.size()
+					<< "\t" << record.suite.size() << "\t" << record.name.size() << "\t" << record.outcome.size() << "\t" << record.report.size() << "\n";
+				ss << record.suite << record.name << record.outcome << record.report;
+				for (AssertionSite const& site : record.sites)
+				{
+					ss << "S\t" << site.line << "\t" << site.hits << "\t" << site.passes << "\t" << site.fails << "\t" << site.nanoseconds
+						<< "\t" << site.file.size() << "\t" << site.expr.size() << "\n";
+					ss << site.file << site.expr;
+				}
+				ss << "E\n";
+				return ss.str();
+			}
+			
+			/**
+			 Read the record at a position.
+			 @param data Contents of the journal.
+			 @param pos Position of the record; moved past it if it is complete.
+			 @param record Set to the record.
+			 @return Whether a complete record was read.
+			 */
+			static inline bool decode(std::string const& data, size_t &pos, CheckpointRecord &record)
+			{
+				size_t p = pos;
+				auto header = [&](char kind, std::stringstream &fields) {
+					size_t end = data.find('\n', p);
+					if (end == std::string::npos || data[p] != kind) return false;
+					fields.str(data.substr(p + 1, end - p - 1));
+					p = end + 1;
+					return true;
+				};
+				auto text = [&](size_t size, std::string &value) {
+					if (data.size() - p < size) return false;
+					value = data.substr(p, size);
+					p += size;
+					return true;
+				};
+				
+				std::stringstream fields;
+				size_t sites, suiteSize, nameSize, outcomeSize, reportSize;
+				record = CheckpointRecord();
+				if (!header('T', fields)) return false;
+				fields >> record.run >> record.position >> record.stats.passes >> record.stats.fails >> record.stats.sampled
+					>> record.stats.skips >> record.stats.aborted >> record.stats.nondeterministic >> sites >> suiteSize >> nameSize >> outcomeSize >> reportSize;
+				if (!fields || !text(suiteSize, record.suite) || !text(nameSize, record.name)
+					|| !text(outcomeSize, record.outcome) || !text(reportSize, record.report)) return false;
+				for (size_t i = 0; i < sites; i++)
+				{
+					AssertionSite site;
+					size_t fileSize, exprSize;
+					std::stringstream siteFields;
+					if (!header('S', siteFields)) return false;
+					siteFields >> site.line >> site.hits >> site.passes >> site.fails >> site.nanoseconds >> fileSize >> exprSize;
+					if (!siteFields || !text(fileSize, site.file) || !text(exprSize, site.expr)) return false;
+					record.sites.push_back(site);
+				}
+				std::stringstream end;
+				if (!header('E', end)) return false;
+				pos = p;
+				return true;
+			}
+			
+			/** Path of the journal, once opened. */
+			std::string path_;
+			
+			/** Tests completed by the interrupted process. */
+			std::vector<CheckpointRecord> records_;
+			
+			/** The journal, open for writing. */
+			std::ofstream out_;
+		};
+		
+		/** @return The checkpoint journal of the process. */
+		inline CheckpointJournal &checkpointJournal()
+		{
+			static CheckpointJournal journal;
+			return journal;
+		}
+	}
+	
+#pragma mark - Random Numbers
+	
+	namespace internal
+	{
+		/**
+		 SplitMix64 step, used to seed generators and to mix seeds.
+		 @param state State, advanced by the step.
+		 @return The next output.
+		 */
+		inline uint64_t splitMix64(uint64_t &state)
+		{
+			uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		}
+		
+		/**
+		 Combine a seed with a number, such that different numbers give unrelated seeds.
+		 @param seed The seed.
+		 @param value The number, e.g. a test index.
+		 @return The combined seed.
+		 */
+		inline uint64_t mixSeed(uint64_t seed, uint64_t value)
+		{
+			uint64_t state = seed ^ (value * 0xd1b54a32d192ed03ULL);
+			return splitMix64(state);
+		}
+		
+		/** Seeds of the current run and test; see TestSuite::seed. */
+		struct RandomState
+		{
+			/** Seed of the run. */
+			uint64_t runSeed = 0;
+			
+			/** Seed of the running test, derived from the run seed and the test index. */
+			uint64_t testSeed = 0;
+			
+			/** Serial number of the last test that used rng(); see testSerial(). */
+			std::atomic<unsigned long> usedSerial{0};
+		};
+		
+		/** @return The random state of the process. */
+		inline RandomState &randomState()
+		{
+			static RandomState state;
+			return state;
+		}
+	}
+	
+	/**
+	 Small, fast pseudo-random number generator: xoshiro256**, seeded through SplitMix64.
+	 Satisfies the *UniformRandomBitGenerator* requirements, so it can be used with the standard distributions.
+	 Seeding takes a few nanoseconds, unlike `std::mt19937` with its 2.5 kB of state.
+	 */
+	class Rng
+	{
+	public:
+		
+		using result_type = uint64_t;
+		
+		/**
+		 Constructor.
+		 @param seed Seed; any value, including 0, gives a good sequence.
+		 */
+		explicit Rng(uint64_t seed = 0)
+		{
+			this->seed(seed);
+		}
+		
+		/**
+		 Restart the sequence.
+		 @param seed Seed.
+		 */
+		inline void seed(uint64_t seed)
+		{
+			for (uint64_t &word : this->state_) word = internal::splitMix64(seed);
+		}
+		
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return ~(result_type)0; }
+		
+		/** @return The next 64 random bits. */
+		inline result_type operator()()
+		{
+			uint64_t *s = this->state_;
+			uint64_t result = rotl(s[1] * 5, 7) * 9;
+			uint64_t t = s[1] << 17;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = rotl(s[3], 45);
+			return result;
+		}
+		
+		/**
+		 Draw a number below a bound, without modulo bias.
+		 @param bound Upper bound, exclusive; must not be 0.
+		 @return Number in `[0, bound)`.
+		 */
+		inline uint64_t below(uint64_t bound)
+		{
+			uint64_t threshold = (0 - bound) % bound;
+			for (;;)
+			{
+				uint64_t r = (*this)();
+				if (r >= threshold) return r % bound;
+			}
+		}
+		
+		/** @return Number in `[0, 1)`, with 53 random bits. */
+		inline double uniform()
+		{
+			return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+		}
+		
+	private:
+		
+		static inline uint64_t rotl(uint64_t x, int k)
+		{
+			return (x << k) | (x >> (64 - k));
+		}
+		
+		/** Generator state. */
+		uint64_t state_[4];
+	};
+	
+	/**
+	 Random number generator of the running test, seeded from the seed of the run, the index of the test and
+	 a worker id. The sequence of a test is the same whichever other tests run, and in whatever order, so a
+	 failure can be replayed with the seed in its report (see TestSuite::seed). Threads started by a test should
+	 each pass their own worker id, to draw from independent sequences that do not depend on thread scheduling.
+	 The generator is restarted for each test; it is local to the calling thread.
+	 @param worker @optional Id of the worker thread within the test.
+	 @return The generator.
+	 */
+	inline Rng &rng(unsigned worker = 0)
+	{
+		struct Stream
+		{
+			unsigned long serial;
+			unsigned worker;
+			Rng generator;
+		};
+		thread_local std::vector<Stream> streams;
+		
+		internal::RandomState &random = internal::randomState();
+		unsigned long serial = internal::testSerial();
+		random.usedSerial.store(serial, std::memory_order_relaxed);
+		for (Stream &stream : streams)
+			if (stream.serial == serial && stream.worker == worker) return stream.generator;
+		// Interleaved async tests keep their streams; those of tests long finished are dropped
+		streams.erase(std::remove_if(streams.begin(), streams.end(), [&](Stream const& stream) { return stream.serial + 256 < serial; }), streams.end());
+		streams.push_back({serial, worker, Rng(internal::mixSeed(random.testSeed, worker))});
+		return streams.back().generator;
+	}
+	
+#pragma mark - Determinism Checks
+	
+	namespace internal
+	{
+		/**
+		 Hash of the sequence of assertion events of one run of a test: the site, the outcome and a digest of the
+		 described values of each assertion. The first run also keeps the events themselves, up to a limit, so that
+		 later runs compared to it can tell the first event that differs.
+		 */
+		class AssertionTrace
+		{
+		public:
+			
+			/** An assertion event. */
+			struct Event
+			{
+				/** Site of the assertion, or `nullptr` if not known. */
+				Site *site = nullptr;
+				
+				/** Whether the assertion passed. */
+				bool passed = true;
+				
+				/** Digest of the site, outcome and values. */
+				uint64_t digest = 0;
+				
+				/** Described values, kept for failed assertions only. */
+				std::string value;
+			};
+			
+			/** Number of events the first run keeps. */
+			static constexpr size_t eventLimit = 1 << 16;
+			
+			/**
+			 Constructor.
+			 @param reference @optional Trace of the first run, to compare with; `nullptr` for the first run.
+			 */
+			AssertionTrace(AssertionTrace const* reference = nullptr)
+			: reference_(reference) {}
+			
+			/**
+			 Start an assertion event.
+			 @param site Site of the assertion, or `nullptr`.
+			 @param passed Whether it passed.
+			 */
+			inline void event(Site *site, bool passed)
+			{
+				this->finish();
+				this->pending_ = Event();
+				this->pending_.site = site;
+				this->pending_.passed = passed;
+				uint64_t state = (uint64_t)(uintptr_t)site ^ (passed ? 0x5bd1e995ULL : 0);
+				this->pending_.digest = splitMix64(state);
+				this->hasPending_ = true;
+			}
+			
+			/**
+			 Add the described values of an assertion to its event.
+			 @param value Description of the values.
+			 */
+			inline void value(std::string const& value)
+			{
+				if (!this->hasPending_) return;
+				uint64_t h = 0xcbf29ce484222325ULL;
+				for (char c : value) h = (h ^ (unsigned char)c) * 0x100000001b3ULL;
+				this->pending_.digest = mixSeed(this->pending_.digest, h);
+				if (!this->pending_.passed) this->pending_.value = value;
+			}
+			
+			/** Add the last event to the trace. */
+			inline void finish()
+			{
+				if (!this->hasPending_) return;
+				this->hasPending_ = false;
+				Event &event = this->pending_;
+				if (!this->reference_)
+				{
+					if (this->events_.size() < eventLimit) this->events_.push_back(event);
+				}
+				else if (this->divergence_ < 0)
+				{
+					// The first difference is only known exactly within the events kept by the first run
+					AssertionTrace const& reference = *this->reference_;
+					bool differs = this->count_ < reference.events_.size()
+						? reference.events_[this->count_].digest != event.digest
+						: this->count_ == reference.count_ && reference.count_ == reference.events_.size();
+					if (differs)
+					{
+						this->divergence_ = this->count_;
+						this->actual_ = event;
+					}
+				}
+				this->hash_ = mixSeed(this->hash_, event.digest);
+				this->count_++;
+			}
+			
+			/**
+			 Compare with the trace of the first run. Call finish() first.
+			 @param run Number of this run.
+			 @return Description of the first difference, or an empty string if the runs were the same.
+			 */
+			inline std::string difference(int run) const
+			{
+				AssertionTrace const& reference = *this->reference_;
+				if (this->hash_ == reference.hash_ && this->count_ == reference.count_) return "";
+				
+				std::stringstream ss;
+				ss << "run " << run << " differs from run 1 ";
+				size_t position = this->divergence_ >= 0 ? (size_t)this->divergence_ : this->count_;
+				if (this->divergence_ < 0 && position >= reference.events_.size())
+				{
+					ss << "after the first " << eventLimit << " assertions";
+					return ss.str();
+				}
+				ss << "at assertion " << position + 1 << ": ";
+				ss << (position < reference.events_.size() ? describe(reference.events_[position]) : "nothing") << ", then ";
+				ss << (this->divergence_ >= 0 ? describe(this->actual_) : "nothing");
+				return ss.str();
+			}
+			
+		private:
+			
+			/** Describe an event. */
+			static inline std::string describe(Event const& event)
+			{
+				std::stringstream ss;
+				if (event.site) ss << "`" << event.site->expr << "` at line " << event.site->line;
+				else ss << "an assertion";
+				ss << (event.passed ? " passed" : " failed");
+				if (!event.value.empty()) ss << " (" << event.value << ")";
+				return ss.str();
+			}
+			
+			/** Trace of the first run, or `nullptr`. */
+			AssertionTrace const* reference_;
+			
+			/** Events of the first run. */
+			std::vector<Event> events_;
+			
+			/** Event being recorded. */
+			Event pending_;
+			bool hasPending_ = false;
+			
+			/** Hash and number of the events so far. */
+			uint64_t hash_ = 0;
+			size_t count_ = 0;
+			
+			/** Position of the first event that differs from the first run, and that event. */
+			long long divergence_ = -1;
+			Event actual_;
+		};
+	}
+	
+#pragma mark - System Call Trapping
+	
+#ifdef LITEST_SECCOMP
+	namespace internal
+	{
+		/** Counters shared with the child process running a block of LT_NO_SYSCALLS. */
+		struct SyscallCounts
+		{
+			/** Number of counters; the last one counts all larger system call numbers. */
+			static constexpr int size = 1024;
+			
+			/** Number of trapped calls, by system call number. */
+			std::atomic<unsigned long long> calls[size];
+			
+			/** 1 if the block returned, 2 if it threw an exception. */
+			std::atomic<int> completed;
+			
+			/** Program break when the filter was installed, returned by trapped `brk` calls to make them fail. */
+			unsigned long long initialBreak;
+		};
+		
+		/** @return The counters of the running block, in the child process. */
+		inline SyscallCounts *&syscallCounts()
+		{
+			static SyscallCounts *counts = nullptr;
+			return counts;
+		}
+		
+		/**
+		 Handler of the signal raised for a trapped system call: counts the call, and makes it fail with `ENOSYS`.
+		 A failed `brk` returns the unchanged program break instead, as libc expects.
+		 */
+		inline void syscallTrapped(int, siginfo_t *info, void *context)
+		{
+			int nr = info->si_syscall;
+			syscallCounts()->calls[nr >= 0 && nr < SyscallCounts::size ? nr : SyscallCounts::size - 1]++;
+			unsigned long long result = nr == __NR_brk ? syscallCounts()->initialBreak : (unsigned long long)-ENOSYS;
+			ucontext_t *uc = static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+			uc->uc_mcontext.gregs[REG_RAX] = (greg_t)result;
+#elif defined(__aarch64__)
+			uc->uc_mcontext.regs[0] = result;
+#endif
+		}
+		
+		/**
+		 Name of a system call, for the common ones.
+		 @param nr System call number.
+		 @return Name, or `nullptr`.
+		 */
+		inline const char *syscallName(int nr)
+		{
+			static const std::map<int, const char*> names = {
+				{ __NR_read, "read" }, { __NR_write, "write" }, { __NR_openat, "openat" }, { __NR_close, "close" },
+				{ __NR_mmap, "mmap" }, { __NR_munmap, "munmap" }, { __NR_mprotect, "mprotect" }, { __NR_madvise, "madvise" },
+				{ __NR_brk, "brk" }, { __NR_futex, "futex" }, { __NR_clock_gettime, "clock_gettime" },
+				{ __NR_clock_nanosleep, "clock_nanosleep" }, { __NR_nanosleep, "nanosleep" }, { __NR_sched_yield, "sched_yield" },
+				{ __NR_getpid, "getpid" }, { __NR_gettid, "gettid" }, { __NR_ioctl, "ioctl" }, { __NR_fstat, "fstat" },
+				{ __NR_getrandom, "getrandom" }, { __NR_rt_sigprocmask, "rt_sigprocmask" }, { __NR_ppoll, "ppoll" },
+				{ __NR_sendto, "sendto" }, { __NR_recvfrom, "recvfrom" }, { __NR_epoll_pwait, "epoll_pwait" },
+				{ __NR_rt_sigaction, "rt_sigaction" }, { __NR_writev, "writev" }, { __NR_tgkill, "tgkill" },
+			};
+			auto name = names.find(nr);
+			return name == names.end() ? nullptr : name->second;
+		}
+		
+		/**
+		 Run a function in a child process in which every system call is trapped and counted.
+		 The filter lets only the calls needed to return from the signal handler and to exit through.
+		 The exception unwinder is warmed up before, so that exceptions thrown by the function can be caught.
+		 @param func The function.
+		 @param timeout Time after which the child is killed, for functions that keep retrying a failing call.
+		 @return Description of the system calls the function made, or of how the child ended early; empty if none.
+		 */
+		template<typename Func>
+		inline std::string runWithoutSyscalls(Func const& func, std::chrono::milliseconds timeout)
+		{
+			void *page = ::mmap(nullptr, sizeof(SyscallCounts), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+			if (page == MAP_FAILED) return "cannot map memory shared with the child process";
+			SyscallCounts *counts = new (page) SyscallCounts();
+			
+			// The parent waits for the write end, which only the child holds, to be closed as the child ends
+			int fds[2];
+			if (::pipe2(fds, O_CLOEXEC) != 0)
+			{
+				::munmap(page, sizeof(SyscallCounts));
+				return "cannot create a pipe";
+			}
+			
+			pid_t pid = ::fork();
+			if (pid == 0)
+			{
+				::close(fds[0]);
+				syscallCounts() = counts;
+				counts->initialBreak = (unsigned long long)(uintptr_t)::sbrk(0);
+				try { throw 0; } catch (int) {}
+				struct sigaction action;
+				std::memset(&action, 0, sizeof action);
+				action.sa_sigaction = &syscallTrapped;
+				action.sa_flags = SA_SIGINFO;
+				sigemptyset(&action.sa_mask);
+				::sigaction(SIGSYS, &action, nullptr);
+				
+#if defined(__x86_64__)
+				const unsigned arch = AUDIT_ARCH_X86_64;
+#else
+				const unsigned arch = AUDIT_ARCH_AARCH64;
+#endif
+				struct sock_filter filter[] = {
+					BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+					BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, arch, 1, 0),
+					BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+					BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+					BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_rt_sigreturn, 3, 0),
+					BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_exit_group, 2, 0),
+					BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_exit, 1, 0),
+					BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+					BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+				};
+				struct sock_fprog program = { (unsigned short)(sizeof filter / sizeof filter[0]), filter };
+				if (::prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0 || ::prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) != 0) ::_exit(3);
+				
+				// From here on, only exiting enters the kernel
+				try
+				{
+					func();
+					counts->completed = 1;
+				}
+				catch (...)
+				{
+					counts->completed = 2;
+				}
+				::_exit(0);
+			}
+			
+			std::stringstream ss;
+			int status = 0;
+			bool timedOut = false;
+			::close(fds[1]);
+			if (pid < 0) ss << "cannot fork: " << std::strerror(errno);
+			else
+			{
+				auto deadline = std::chrono::steady_clock::now() + timeout;
+				pollfd pfd = { fds[0], POLLIN, 0 };
+				while (true)
+				{
+					auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+					int ready = left.count() > 0 ? ::poll(&pfd, 1, (int)left.count()) : 0;
+					if (ready > 0) break;
+					if (ready == 0) { timedOut = true; ::kill(pid, SIGKILL); break; }
+					if (errno != EINTR) break;
+				}
+				while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+			}
+			::close(fds[0]);
+			
+			unsigned long long total = 0;
+			for (int nr = 0; nr < SyscallCounts::size; nr++) total += counts->calls[nr];
+			if (pid > 0 && total > 0)
+			{
+				ss << total << " system call" << (total == 1 ? "" : "s") << ":";
+				for (int nr = 0; nr < SyscallCounts::size; nr++)
+				{
+					if (counts->calls[nr] == 0) continue;
+					const char *name = syscallName(nr);
+					ss << " " << (name ? name : "syscall") << " (" << (nr < SyscallCounts::size - 1 ? std::to_string(nr) : "larger") << ")";
+					if (counts->calls[nr] > 1) ss << " x " << counts->calls[nr];
+					ss << ",";
+				}
+			}
+			if (pid > 0 && counts->completed != 1)
+			{
+				if (total > 0) ss << " then ";
+				if (counts->completed == 2) ss << "the block threw an exception";
+				else if (timedOut) ss << "the block did not finish within " << timeout.count() << " ms and was killed";
+				else if (WIFSIGNALED(status)) ss << "the block was ended by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+				else if (WIFEXITED(status) && WEXITSTATUS(status) == 3 && total == 0) ss << "cannot install a seccomp filter";
+				else ss << "the block exited with status " << WEXITSTATUS(status);
+			}
+			std::string description = ss.str();
+			if (!description.empty() && description.back() == ',') description.pop_back();
+			
+			counts->~SyscallCounts();
+			::munmap(page, sizeof(SyscallCounts));
+			return description;
+		}
+	}
+#endif
+	
+#pragma mark - Virtual Clock
+	
+	/**
+	 A clock under the control of tests, satisfying the standard Clock requirements.
+	 
+	 Code with timeouts and sleeps can be templated on its clock type, and tested with VirtualClock instead of
+	 `std::chrono::steady_clock`. Tests move time forward with advance(), instantly. Code that sleeps should
+	 call `Clock::sleep_for()` or `Clock::sleep_until()`, as `std::this_thread` sleeps for real time with
+	 any clock: with auto-advance on (the default), a virtual sleep moves time to its end at once; otherwise it
+	 blocks until another thread advances time far enough.
+	 
+	 The clock is global to the process and starts at zero.
+	 */
+	class VirtualClock
+	{
+	public:
+		
+		/** Representation of ticks. */
+		using rep = std::chrono::nanoseconds::rep;
+		
+		/** Tick period. */
+		using period = std::chrono::nanoseconds::period;
+		
+		/** Duration type. */
+		using duration = std::chrono::nanoseconds;
+		
+		/** Time point type. */
+		using time_point = std::chrono::time_point<VirtualClock>;
+		
+		/** Time never goes backwards, except through reset(). */
+		static constexpr bool is_steady = true;
+		
+		/**
+		 Current virtual time.
+		 @return Time point.
+		 */
+		static inline time_point now() noexcept
+		{
+			return time_point(duration(state().now.load()));
+		}
+		
+		/**
+		 Move time forward, waking sleepers whose time has come.
+		 @param d Duration to advance by; negative durations are ignored.
+		 */
+		static inline void advance(duration d)
+		{
+			if (d.count() <= 0) return;
+			std::lock_guard<std::mutex> lock(state().mutex);
+			state().now += d.count();
+			state().changed.notify_all();
+		}
+		
+		/**
+		 Move time forward to a time point, if it is in the future.
+		 @param t Time point.
+		 */
+		static inline void advanceTo(time_point t)
+		{
+			advance(t - now());
+		}
+		
+		/** Set time back to zero, turn auto-advance on and fast-forward off. Only call while no thread sleeps on the clock. */
+		static inline void reset()
+		{
+			std::lock_guard<std::mutex> lock(state().mutex);
+			state().now = 0;
+			state().autoAdvance = true;
+			state().fastForward = false;
+		}
+		
+		/**
+		 Choose whether LT_EVENTUALLY runs on virtual time.
+		 @param on If `true`, LT_EVENTUALLY measures its timeout in virtual time and advances the clock instead of
+		 sleeping between polls, so waiting for code that uses VirtualClock takes no real time.
+		 */
+		static inline void setFastForward(bool on)
+		{
+			std::lock_guard<std::mutex> lock(state().mutex);
+			state().fastForward = on;
+		}
+		
+		/**
+		 Whether LT_EVENTUALLY runs on virtual time; see setFastForward().
+		 @return `true` if fast-forward is on.
+		 */
+		static inline bool fastForward()
+		{
+			std::lock_guard<std::mutex> lock(state().mutex);
+			return state().fastForward;
+		}
+		
+		/**
+		 Choose whether sleeping moves time forward.
+		 @param on If `true`, sleeps return at once after advancing time to their end. If `false`, they block
+		 until time is advanced by another thread.
+		 */
+		static inline void setAutoAdvance(bool on)
+		{
+			std::lock_guard<std::mutex> lock(state().mutex);
+			state().autoAdvance = on;
+		}
+		
+		/**
+		 Sleep until a virtual time point.
+		 @param t Time point.
+		 */
+		static inline void sleep_until(time_point t)
+		{
+			std::unique_lock<std::mutex> lock(state().mutex);
+			if (state().autoAdvance)
+			{
+				if (state().now < t.time_since_epoch().count())
+				{
+					state().now = t.time_since_epoch().count();
+					state().changed.notify_all();
+				}
+				return;
+			}
+			state().changed.wait(lock, [t] { return state().now >= t.time_since_epoch().count(); });
+		}
+		
+		/**
+		 Sleep for a virtual duration.
+		 @param d Duration.
+		 */
+		static inline void sleep_for(duration d)
+		{
+			sleep_until(now() + d);
+		}
+		
+	private:
+		
+		/** Shared state of the clock. */
+		struct State
+		{
+			/** Current time in nanoseconds. Written under mutex, read without it. */
+			std::atomic<rep> now{0};
+			
+			/** Whether sleeps advance time. */
+			bool autoAdvance = true;
+			
+			/** Whether LT_EVENTUALLY advances time instead of sleeping. */
+			bool fastForward = false;
+			
+			/** Protects changes of time. */
+			std::mutex mutex;
+			
+			/** Notified whenever time advances. */
+			std::condition_variable changed;
+		};
+		
+		/**
+		 The state of the clock.
+		 @return Reference to the state.
+		 */
+		static inline State &state()
+		{
+			static State s;
+			return s;
+		}
+	};
+	
+#pragma mark - Cached Inputs
+	
+	/**
+	 Test input data that is generated once and cached on disk; see LT_CACHED_INPUT.
+	 On a cache hit the data is mapped read-only from the cache file, otherwise it is held in memory.
+	 Move-only.
+	 @tparam T Element type. Must be trivially copyable.
+	 */
+	template<typename T>
+	class CachedInput
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Cached input elements must be trivially copyable");
+		
+	public:
+		
+		/**
+		 Constructor for freshly generated data.
+		 @param data The data.
+		 */
+		CachedInput(std::vector<T> &&data)
+		: generated_(std::move(data)), data_(generated_.data()), size_(generated_.size()) {}
+		
+		/**
+		 Constructor for data mapped from a cache file.
+		 @param mapping Start of the mapping, owned by the object.
+		 @param mappingSize Size of the mapping in bytes.
+		 @param offset Offset of the first element in the mapping.
+		 @param size Number of elements.
+		 */
+		CachedInput(void *mapping, size_t mappingSize, size_t offset, size_t size)
+		: data_(reinterpret_cast<const T*>(static_cast<const char*>(mapping) + offset)), size_(size),
+		  mapping_(mapping), mappingSize_(mappingSize) {}
+		
+		CachedInput(CachedInput &&other)
+		: generated_(std::move(other.generated_)), data_(other.data_), size_(other.size_),
+		  mapping_(other.mapping_), mappingSize_(other.mappingSize_)
+		{
+			if (!this->mapping_) this->data_ = this->generated_.data();
+			other.mapping_ = nullptr;
+			other.data_ = nullptr;
+			other.size_ = 0;
+		}
+		
+		CachedInput(CachedInput const&) = delete;
+		CachedInput& operator=(CachedInput const&) = delete;
+		
+		/** Destructor. Unmaps the cache file. */
+		~CachedInput()
+		{
+#ifdef LITEST_POSIX
+			if (this->mapping_) ::munmap(this->mapping_, this->mappingSize_);
+#endif
+		}
+		
+		/** @return Pointer to the first element. */
+		inline const T* data() const { return this->data_; }
+		
+		/** @return Number of elements. */
+		inline size_t size() const { return this->size_; }
+		
+		/** @return Whether there are no elements. */
+		inline bool empty() const { return this->size_ == 0; }
+		
+		/** @return Iterator to the first element. */
+		inline const T* begin() const { return this->data_; }
+		
+		/** @return Iterator past the last element. */
+		inline const T* end() const { return this->data_ + this->size_; }
+		
+		/**
+		 Access an element.
+		 @param i Index.
+		 @return The element.
+		 */
+		inline const T& operator[](size_t i) const { return this->data_[i]; }
+		
+		/** @return Whether the data was read from the cache rather than generated. */
+		inline bool cached() const { return this->mapping_ != nullptr; }
+		
+	private:
+		
+		/** Generated data, if not mapped. */
+		std::vector<T> generated_;
+		
+		/** First element. */
+		const T* data_;
+		
+		/** Number of elements. */
+		size_t size_;
+		
+		/** Mapping of the cache file, or `nullptr`. */
+		void *mapping_ = nullptr;
+		
+		/** Size of the mapping in bytes. */
+		size_t mappingSize_ = 0;
+	};
+	
+	namespace internal
+	{
+		/**
+		 64-bit FNV-1a hash.
+		 @param data Bytes to hash.
+		 @param size Number of bytes.
+		 @param hash @optional Hash to continue from.
+		 @return Hash.
+		 */
+		inline uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL)
+		{
+			const unsigned char *bytes = static_cast<const unsigned char*>(data);
+			for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+			return hash;
+		}
+		
+		/**
+		 Path of the running binary.
+		 @return Path of the executable, or an empty string if unknown.
+		 */
+		inline std::string binaryPath()
+		{
+#ifdef __linux__
+			char path[4096];
+			ssize_t n = ::readlink("/proc/self/exe", path, sizeof(path) - 1);
+			return n > 0 ? std::string(path, n) : "";
+#else
+			return "";
+#endif
+		}
+		
+		/**
+		 Identify the running binary, so that caches are invalidated when it is rebuilt.
+		 @return Path, size and modification time of the executable, or an empty string if unknown.
+		 */
+		inline std::string binaryVersion()
+		{
+#ifdef __linux__
+			struct stat st;
+			std::string path = binaryPath();
+			if (path.empty() || ::stat("/proc/self/exe", &st) != 0) return "";
+			return path + ":" + std::to_string((long long)st.st_size) + ":" + std::to_string((long long)st.st_mtime);
+#else
+			return "";
+#endif
+		}
+		
+		/** Header of a cache file. */
+		struct CacheHeader
+		{
+			/** "LTCACHE1". */
+			char magic[8];
+			
+			/** Cache key hash, checked against the file name. */
+			uint64_t key;
+			
+			/** Size of an element in bytes. */
+			uint64_t elementSize;
+			
+			/** Number of elements. */
+			uint64_t count;
+		};
+	}
+	
+	/**
+	 Directory holding cached inputs: the `LITEST_CACHE_DIR` environment variable if set, else `.litest-cache`.
+	 @return Directory path.
+	 */
+	inline std::string cacheDirectory()
+	{
+		const char *env = std::getenv(LITEST_CACHE_DIR_ENV);
+		return env && *env ? env : ".litest-cache";
+	}
+	
+	/**
+	 Get input data from the cache, or generate and cache it. Used by LT_CACHED_INPUT.
+	 
+	 The cache file is named after a hash of the key, the generator source, the element size and the version of
+	 the running binary, so data is never reused after the generator or the binary changed. Files are written to
+	 a temporary name and renamed, so concurrent runs never see partial files. Any error falls back to generating.
+	 The name starts with a hash of the key and the path of the binary; on a miss, other files starting with it
+	 are stale versions of the same input and are removed, so the cache does not grow with every rebuild.
+	 
+	 @tparam Func Type of the generator; must return a `std::vector` of trivially copyable elements.
+	 @param key Name of the input.
+	 @param source Source text of the generator.
+	 @param generate The generator.
+	 @return The data.
+	 */
+	template<typename Func>
+	inline auto cachedInput(std::string const& key, std::string const& source, Func const& generate) -> CachedInput<typename decltype(generate())::value_type>
+	{
+		using T = typename decltype(generate())::value_type;
+#ifdef LITEST_POSIX
+		std::string identity = key + '\0' + source + '\0' + std::to_string(sizeof(T)) + '\0' + internal::binaryVersion();
+		std::string slotIdentity = key + '\0' + internal::binaryPath();
+		uint64_t hash = internal::fnv1a(identity.data(), identity.size());
+		std::stringstream slot, name;
+		slot << std::hex << std::setw(16) << std::setfill('0') << internal::fnv1a(slotIdentity.data(), slotIdentity.size()) << "-";
+		name << slot.str() << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+		std::string path = cacheDirectory() + "/" + name.str();
+		
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd >= 0)
+		{
+			struct stat st;
+			internal::CacheHeader header;
+			bool valid = ::fstat(fd, &st) == 0 && ::pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)
+				&& std::memcmp(header.magic, "LTCACHE1", 8) == 0 && header.key == hash && header.elementSize == sizeof(T)
+				&& (uint64_t)st.st_size == sizeof(header) + header.count * sizeof(T);
+			void *mapping = valid ? ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+			::close(fd);
+			if (mapping != MAP_FAILED) return CachedInput<T>(mapping, st.st_size, sizeof(header), header.count);
+		}
+		
+		std::vector<T> data = generate();
+		::mkdir(cacheDirectory().c_str(), 0755);
+		if (DIR *dir = ::opendir(cacheDirectory().c_str()))
+		{
+			while (dirent *entry = ::readdir(dir))
+			{
+				std::string file = entry->d_name;
+				if (file.compare(0, slot.str().size(), slot.str()) == 0 && file != name.str()
+					&& file.size() > 4 && file.compare(file.size() - 4, 4, ".bin") == 0)
+					::unlink((cacheDirectory() + "/" + file).c_str());
+			}
+			::closedir(dir);
+		}
+		std::string temp = path + "." + std::to_string((long long)::getpid()) + ".tmp";
+		fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd >= 0)
+		{
+			internal::CacheHeader header;
+			std::memcpy(header.magic, "LTCACHE1", 8);
+			header.key = hash;
+			header.elementSize = sizeof(T);
+			header.count = data.size();
+			bool ok = ::write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header);
+			const char *bytes = reinterpret_cast<const char*>(data.data());
+			size_t done = 0, total = data.size() * sizeof(T);
+			while (ok && done < total)
+			{
+				ssize_t n = ::write(fd, bytes + done, total - done);
+				ok = n > 0;
+				if (ok) done += n;
+			}
+			::close(fd);
+			if (!ok || ::rename(temp.c_str(), path.c_str()) != 0) ::unlink(temp.c_str());
+		}
+		return CachedInput<T>(std::move(data));
+#else
+		return CachedInput<T>(generate());
+#endif
+	}
+	
+	namespace internal
+	{
+		/** Wakes LT_EVENTUALLY waits; see litest::wakeWaiters(). */
+		struct Waiters
+		{
+			/** Protects generation. */
+			std::mutex mutex;
+			
+			/** Notified by wakeWaiters(). */
+			std::condition_variable woken;
+			
+			/** Number of wakeWaiters() calls. */
+			unsigned long generation = 0;
+		};
+		
+		/**
+		 The shared Waiters.
+		 @return Reference to the Waiters.
+		 */
+		inline Waiters &waiters()
+		{
+			static Waiters w;
+			return w;
+		}
+	}
+	
+	/**
+	 Make all LT_EVENTUALLY assertions that are waiting poll their expressions again at once.
+	 Meant to be hooked into the code under test where it changes state, for example as a callback.
+	 Thread-safe.
+	 */
+	inline void wakeWaiters()
+	{
+		internal::Waiters &w = internal::waiters();
+		std::lock_guard<std::mutex> lock(w.mutex);
+		w.generation++;
+		w.woken.notify_all();
+	}
+	
+#pragma mark - Async Tests
+	
+#ifdef LITEST_COROUTINES
+	/** Coroutine tests, multiplexed on an event loop. See LT_ADD_ASYNC_TEST. */
+	namespace async
+	{
+		class EventLoop;
+		
+		/**
+		 A coroutine. The body of an async test is a Task, and Tasks can `co_await` other Tasks.
+		 A Task starts suspended; it runs when spawned on an EventLoop or awaited.
+		 */
+		class Task
+		{
+		public:
+			
+			/** Coroutine promise of a Task. */
+			struct promise_type
+			{
+				/** Exception thrown out of the coroutine body, if any. */
+				std::exception_ptr exception;
+				
+				/** Coroutine awaiting this one, resumed when it completes. */
+				std::coroutine_handle<> continuation;
+				
+				/** Event loop the Task was spawned on, if it is not awaited by another Task. */
+				EventLoop *loop = nullptr;
+				
+				/** Resumes the awaiting coroutine, or tells the event loop that the Task is done. */
+				struct FinalAwaiter
+				{
+					bool await_ready() noexcept { return false; }
+					inline std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+					void await_resume() noexcept {}
+				};
+				
+				Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				FinalAwaiter final_suspend() noexcept { return {}; }
+				void return_void() {}
+				void unhandled_exception() { this->exception = std::current_exception(); }
+			};
+			
+			/**
+			 Constructor.
+			 @param handle Handle of the coroutine, owned by the Task.
+			 */
+			explicit Task(std::coroutine_handle<promise_type> handle)
+			: handle_(handle) {}
+			
+			Task(Task &&other) noexcept
+			: handle_(other.handle_) { other.handle_ = nullptr; }
+			
+			Task(Task const&) = delete;
+			Task& operator=(Task const&) = delete;
+			
+			/** Destructor. Destroys the coroutine. */
+			~Task()
+			{
+				if (this->handle_) this->handle_.destroy();
+			}
+			
+			/**
+			 The coroutine.
+			 @return Handle of the coroutine.
+			 */
+			inline std::coroutine_handle<promise_type> handle() const { return this->handle_; }
+			
+			/** @name Awaiting a Task runs it to completion, and rethrows its exception. */
+			/**@{*/
+			bool await_ready() const noexcept { return this->handle_.done(); }
+			
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				this->handle_.promise().continuation = awaiting;
+				return this->handle_;
+			}
+			
+			void await_resume()
+			{
+				if (this->handle_.promise().exception) std::rethrow_exception(this->handle_.promise().exception);
+			}
+			/**@}*/
+			
+		private:
+			
+			/** Handle of the coroutine. */
+			std::coroutine_handle<promise_type> handle_;
+		};
+		
+		/**
+		 Single-threaded event loop resuming coroutines when file descriptors become ready (with `epoll`),
+		 timers expire, or other threads post them.
+		 
+		 Every coroutine belongs to an *owner*, the async test it runs for. The loop calls onSwitch before resuming a
+		 coroutine of another owner than the last one, so that assertions are attributed to the right test.
+		 */
+		class EventLoop
+		{
+		public:
+			
+			/** A coroutine waiting for a file descriptor. */
+			struct FdWaiter
+			{
+				/** The file descriptor. */
+				int fd;
+				
+				/** `epoll` events waited for. */
+				uint32_t events;
+				
+				/** Coroutine to resume. */
+				std::coroutine_handle<> handle;
+				
+				/** Owner of the coroutine. */
+				int owner;
+			};
+			
+			/** Constructor. */
+			EventLoop()
+			{
+				this->epoll_ = ::epoll_create1(EPOLL_CLOEXEC);
+				this->wake_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+				epoll_event event{};
+				event.events = EPOLLIN;
+				event.data.ptr = nullptr;
+				::epoll_ctl(this->epoll_, EPOLL_CTL_ADD, this->wake_, &event);
+			}
+			
+			EventLoop(EventLoop const&) = delete;
+			EventLoop& operator=(EventLoop const&) = delete;
+			
+			/** Destructor. */
+			~EventLoop()
+			{
+				::close(this->epoll_);
+				::close(this->wake_);
+			}
+			
+			/**
+			 The event loop running on this thread.
+			 @return Reference to the pointer to the loop, `nullptr` outside EventLoop::run().
+			 */
+			static inline EventLoop *&current()
+			{
+				static thread_local EventLoop *loop = nullptr;
+				return loop;
+			}
+			
+			/**
+			 Owner of the coroutine that is running, or of the next Task spawned.
+			 @return Owner.
+			 */
+			inline int owner() const { return this->owner_; }
+			
+			/**
+			 Set the owner of the next Task spawned.
+			 @param owner Owner.
+			 */
+			inline void setOwner(int owner) { this->owner_ = owner; }
+			
+			/**
+			 Start a Task when the loop runs. The loop keeps it until it completes.
+			 @param task The Task.
+			 */
+			inline void spawn(Task task)
+			{
+				std::coroutine_handle<Task::promise_type> handle = task.handle();
+				handle.promise().loop = this;
+				this->schedule(handle, this->owner_);
+				this->roots_.emplace(handle.address(), Root{std::move(task), this->owner_});
+			}
+			
+			/**
+			 Resume a coroutine in the next round of the loop.
+			 @param handle The coroutine.
+			 @param owner Its owner.
+			 */
+			inline void schedule(std::coroutine_handle<> handle, int owner)
+			{
+				this->ready_.push_back({handle, owner});
+			}
+			
+			/**
+			 Resume a coroutine when a deadline has passed.
+			 @param deadline Deadline.
+			 @param handle The coroutine.
+			 */
+			inline void addTimer(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle)
+			{
+				this->timers_.push({deadline, this->timerSerial_++, {handle, this->owner_}});
+			}
+			
+			/**
+			 Resume a coroutine when a file descriptor is ready. Only one coroutine may wait for a descriptor at a time.
+			 @param waiter The waiting coroutine; must stay valid until it is resumed.
+			 @throws std::system_error If the descriptor cannot be waited for, for example because it is a regular file.
+			 */
+			inline void waitFd(FdWaiter *waiter)
+			{
+				epoll_event event{};
+				event.events = waiter->events;
+				event.data.ptr = waiter;
+				if (::epoll_ctl(this->epoll_, EPOLL_CTL_ADD, waiter->fd, &event) != 0)
+					throw std::system_error(errno, std::generic_category(), "Cannot wait for file descriptor " + std::to_string(waiter->fd));
+				this->fdWaiters_++;
+			}
+			
+			/** Announce that another thread will post() a coroutine; keeps the loop from giving up on it. */
+			inline void expectPost()
+			{
+				std::lock_guard<std::mutex> lock(this->postMutex_);
+				this->expectedPosts_++;
+			}
+			
+			/**
+			 Resume a coroutine on the loop's thread. Thread-safe; must be announced with expectPost().
+			 @param handle The coroutine.
+			 @param owner Its owner.
+			 */
+			inline void post(std::coroutine_handle<> handle, int owner)
+			{
+				{
+					std::lock_guard<std::mutex> lock(this->postMutex_);
+					this->posted_.push_back({handle, owner});
+				}
+				uint64_t one = 1;
+				ssize_t written = ::write(this->wake_, &one, sizeof(one));
+				(void)written;
+			}
+			
+			/** Called before resuming a coroutine of another owner. */
+			std::function<void(int)> onSwitch;
+			
+			/** Called when a spawned Task completes, with its owner and the exception it threw, if any. */
+			std::function<void(int, std::exception_ptr)> onFinish;
+			
+			/**
+			 Run until all spawned Tasks completed.
+			 Tasks that wait for nothing that could resume them are finished with an exception.
+			 */
+			inline void run()
+			{
+				EventLoop *previous = current();
+				current() = this;
+				while (!this->roots_.empty())
+				{
+					while (!this->ready_.empty())
+					{
+						Entry entry = this->ready_.front();
+						this->ready_.pop_front();
+						this->resume(entry);
+					}
+					if (this->roots_.empty()) break;
+					
+					bool expectingPosts;
+					{
+						std::lock_guard<std::mutex> lock(this->postMutex_);
+						expectingPosts = this->expectedPosts_ > 0;
+					}
+					if (this->timers_.empty() && this->fdWaiters_ == 0 && !expectingPosts)
+					{
+						this->abandonAll();
+						break;
+					}
+					
+					int timeout = -1;
+					if (!this->timers_.empty())
+					{
+						auto wait = this->timers_.top().deadline - std::chrono::steady_clock::now();
+						timeout = wait.count() <= 0 ? 0 : (int)std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+					}
+					
+					epoll_event events[64];
+					int n = ::epoll_wait(this->epoll_, events, 64, timeout);
+					for (int i = 0; i < n; i++)
+					{
+						FdWaiter *waiter = static_cast<FdWaiter*>(events[i].data.ptr);
+						if (!waiter)
+						{
+							uint64_t count;
+							ssize_t got = ::read(this->wake_, &count, sizeof(count));
+							(void)got;
+							std::lock_guard<std::mutex> lock(this->postMutex_);
+							this->expectedPosts_ -= this->posted_.size();
+							this->ready_.insert(this->ready_.end(), this->posted_.begin(), this->posted_.end());
+							this->posted_.clear();
+							continue;
+						}
+						::epoll_ctl(this->epoll_, EPOLL_CTL_DEL, waiter->fd, nullptr);
+						this->fdWaiters_--;
+						this->schedule(waiter->handle, waiter->owner);
+					}
+					
+					auto now = std::chrono::steady_clock::now();
+					while (!this->timers_.empty() && this->timers_.top().deadline <= now)
+					{
+						this->ready_.push_back(this->timers_.top().entry);
+						this->timers_.pop();
+					}
+				}
+				current() = previous;
+			}
+			
+		private:
+			
+			friend struct Task::promise_type::FinalAwaiter;
+			
+			/** A coroutine to resume and its owner. */
+			struct Entry
+			{
+				std::coroutine_handle<> handle;
+				int owner;
+			};
+			
+			/** A spawned Task. */
+			struct Root
+			{
+				Task task;
+				int owner;
+			};
+			
+			/** A coroutine waiting for a deadline. */
+			struct Timer
+			{
+				std::chrono::steady_clock::time_point deadline;
+				unsigned long serial;
+				Entry entry;
+				
+				/** Orders the timer queue by deadline, then by creation. */
+				bool operator<(Timer const& other) const
+				{
+					return this->deadline != other.deadline ? this->deadline > other.deadline : this->serial > other.serial;
+				}
+			};
+			
+			/**
+			 Resume a coroutine, and finish the spawned Tasks that completed.
+			 @param entry The coroutine and its owner.
+			 */
+			inline void resume(Entry entry)
+			{
+				if (entry.owner != this->owner_ && this->onSwitch) this->onSwitch(entry.owner);
+				this->owner_ = entry.owner;
+				entry.handle.resume();
+				
+				while (!this->finished_.empty())
+				{
+					auto found = this->roots_.find(this->finished_.back());
+					this->finished_.pop_back();
+					if (found == this->roots_.end()) continue;
+					int owner = found->second.owner;
+					std::exception_ptr exception = found->second.task.handle().promise().exception;
+					this->roots_.erase(found);
+					if (owner != this->owner_ && this->onSwitch) this->onSwitch(owner);
+					this->owner_ = owner;
+					if (this->onFinish) this->onFinish(owner, exception);
+				}
+			}
+			
+			/** Finish the remaining Tasks, which can never be resumed. */
+			inline void abandonAll()
+			{
+				for (auto &root : this->roots_)
+				{
+					if (root.second.owner != this->owner_ && this->onSwitch) this->onSwitch(root.second.owner);
+					this->owner_ = root.second.owner;
+					std::exception_ptr exception = std::make_exception_ptr(std::runtime_error("Async test waits for something that never happens"));
+					if (this->onFinish) this->onFinish(root.second.owner, exception);
+				}
+				this->roots_.clear();
+			}
+			
+			/** The `epoll` instance. */
+			int epoll_;
+			
+			/** `eventfd` that wakes the loop when coroutines are posted. */
+			int wake_;
+			
+			/** Owner of the running coroutine. */
+			int owner_ = -1;
+			
+			/** Spawned Tasks that did not complete, by coroutine address. */
+			std::map<void*, Root> roots_;
+			
+			/** Coroutines to resume. */
+			std::deque<Entry> ready_;
+			
+			/** Coroutines waiting for deadlines. */
+			std::priority_queue<Timer> timers_;
+			
+			/** Creation counter of timers, so that timers with the same deadline run in order. */
+			unsigned long timerSerial_ = 0;
+			
+			/** Number of coroutines waiting for file descriptors. */
+			int fdWaiters_ = 0;
+			
+			/** Spawned Tasks that completed, by coroutine address. */
+			std::vector<void*> finished_;
+			
+			/** Protects posted_ and expectedPosts_. */
+			std::mutex postMutex_;
+			
+			/** Coroutines posted by other threads. */
+			std::vector<Entry> posted_;
+			
+			/** Number of announced posts that did not arrive yet. */
+			long expectedPosts_ = 0;
+		};
+		
+		inline std::coroutine_handle<> Task::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+		{
+			promise_type &promise = handle.promise();
+			if (promise.continuation) return promise.continuation;
+			if (promise.loop) promise.loop->finished_.push_back(handle.address());
+			return std::noop_coroutine();
+		}
+		
+		/** Awaitable suspending until a deadline. */
+		struct SleepAwaiter
+		{
+			/** Deadline. */
+			std::chrono::steady_clock::time_point deadline;
+			
+			bool await_ready() const { return this->deadline <= std::chrono::steady_clock::now(); }
+			void await_suspend(std::coroutine_handle<> handle) { EventLoop::current()->addTimer(this->deadline, handle); }
+			void await_resume() {}
+		};
+		
+		/**
+		 Suspend the calling coroutine for a time, letting other async tests run.
+		 @param duration Time to sleep.
+		 @return Awaitable.
+		 */
+		inline SleepAwaiter sleepFor(std::chrono::nanoseconds duration)
+		{
+			return {std::chrono::steady_clock::now() + duration};
+		}
+		
+		/** Awaitable suspending until a file descriptor is ready. */
+		struct FdAwaiter
+		{
+			/** The waiter registered with the event loop. */
+			EventLoop::FdWaiter waiter;
+			
+			bool await_ready() const { return false; }
+			
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				this->waiter.handle = handle;
+				this->waiter.owner = EventLoop::current()->owner();
+				EventLoop::current()->waitFd(&this->waiter);
+			}
+			
+			void await_resume() {}
+		};
+		
+		/**
+		 Suspend the calling coroutine until a file descriptor is readable.
+		 @param fd File descriptor, e.g. a socket or a pipe.
+		 @return Awaitable.
+		 */
+		inline FdAwaiter readable(int fd)
+		{
+			return {{fd, EPOLLIN | EPOLLRDHUP, nullptr, -1}};
+		}
+		
+		/**
+		 Suspend the calling coroutine until a file descriptor is writable.
+		 @param fd File descriptor, e.g. a socket or a pipe.
+		 @return Awaitable.
+		 */
+		inline FdAwaiter writable(int fd)
+		{
+			return {{fd, EPOLLOUT, nullptr, -1}};
+		}
+		
+		/**
+		 Awaitable suspending until a future is ready. The future is waited for on a helper thread.
+		 @tparam T Value type of the future.
+		 */
+		template<typename T>
+		struct FutureAwaiter
+		{
+			/** The future. */
+			std::future<T> &future;
+			
+			bool await_ready() const { return this->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+			
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				EventLoop *loop = EventLoop::current();
+				int owner = loop->owner();
+				loop->expectPost();
+				std::future<T> *future = &this->future;
+				std::thread([future, loop, handle, owner] { future->wait(); loop->post(handle, owner); }).detach();
+			}
+			
+			T await_resume() { return this->future.get(); }
+		};
+		
+		/**
+		 Suspend the calling coroutine until a future is ready.
+		 @param future The future.
+		 @return Awaitable, whose result is the value of the future.
+		 */
+		template<typename T>
+		inline FutureAwaiter<T> ready(std::future<T> &future)
+		{
+			return {future};
+		}
+	}
+#endif
+	
+	/**
+	 Astract class for formatting of test result output.
+	 
+	 A class to be overridden, not instanced.
+	 Derived classes implement a specific output format; this root class
+	 provies stubs of virtual member functions for the stages in the test life cycle
+	 (like formatTestHeader()) and for test events (like formatPassedCheck()).
+	 */
+	class TestResultFormatter
+	{
+	public:
+		
+		/**
+		 Constructor.
+		 @param ostr Output stream to be used by this instance.
+		 */
+		TestResultFormatter(std::ostream &ostr)
+		: s(ostr)
+		{}
+		
+		/**
+		 Pure virtual destructor.
+		 Ensures that TestResultFormatter is an abstract class.
+		 */
+		virtual ~TestResultFormatter() = 0;
+		
+		// For entire tests
+		
+		/**@{*/
+		/** @name Test lifecycle functions */
+		
+		/**
+		 Called at the start of a test run with information about the test.
+		 Does nothing unless overridden.
+		 @param test Test to be run.
+		 */
+		virtual void formatTestHeader(Test const& test) {}
+		
+		/**
+		 Called at the end of a test run with statistics from the run.
+		 Does nothing unless overridden.
+		 @param test The running test.
+		 @param stats TestStats from the current test run.
+		 */
+		virtual void formatTestFooter(Test const& test, TestStats stats) {}
+		
+		/**
+		 Called before the test footer with the standard output and standard error of the test, if captured and
+		 to be reported; see TestSuite::captureOutput.
+		 Does nothing unless overridden.
+		 @param test The running test.
+		 @param output Captured output. Use CapturedOutput::writeTo() to splice it into the report.
+		 */
+		virtual void formatCapturedOutput(Test const& test, CapturedOutput const& output) {}
+		
+		/**
+		 Called when a test is aborted.
+		 Does nothing unless overridden.
+		 @param line The source line number where the test was aborted.
+		 @param reason Reason for the abortion.
+		 */
+		virtual void formatAbortedTest(int line, std::string reason) {}
+		
+		/**
+		 Called instead of running a test, when a test it depends on did not pass; see TestSuite::addDependency().
+		 Does nothing unless overridden.
+		 @param test The skipped test.
+		 @param reason Why the test was skipped, e.g. "dependency X failed".
+		 */
+		virtual void formatSkippedTest(Test const& test, std::string reason) {}
+		
+		/**
+		 Called before the footer of a failed test that used litest::rng(), so that the failure can be replayed.
+		 Does nothing unless overridden.
+		 @param seed Seed of the run; see TestSuite::seed.
+		 */
+		virtual void formatRandomSeed(uint64_t seed) {}
+		
+		/**
+		 Called before the footer of a test whose assertions differed between runs; see TestSuite::determinismRuns.
+		 Does nothing unless overridden.
+		 @param difference Description of the first difference.
+		 */
+		virtual void formatNondeterminism(std::string difference) {}
+		
+		/**
+		 Text that completes the report when a test crashes, written after the last words of the test;
+		 see TestSuite::crashHandling. Asked for before tests run. Returns an empty string unless overridden.
+		 @return Text closing the report.
+		 */
+		virtual std::string crashEpilogue() const { return ""; }
+		
+		/**
+		 Called when an entire TestSuite starts to run.
+		 Does nothing unless overridden.
+		 @param suite Current test suite.
+		 */
+		virtual void formatTestSuiteStart(TestSuite const& suite) {}
+		
+		/**
+		 Called at the end of a test suite.
+		 Does nothing unless overridden.
+		 @param suite Current test suite.
+		 */
+		virtual void formatTestSuiteEnd(TestSuite const& suite) {}
+		
+		/**
+		 Called before formatTestSuiteEnd() with the assertion sites of the suite and their counters.
+		 Does nothing unless overridden.
+		 @param sites Sites ordered by file and line; see TestSuite::assertionSites().
+		 */
+		virtual void formatAssertionSites(std::vector<AssertionSite> const& sites) {}
+		
+		/**@}*/
+		/**@{*/
+		/** @name Test event functions */
+		
+		/**
+		 Called when a check assertion passed.
+		 Does nothing unless overridden.
+		 @param line Line number where the assertion was defined.
+		 @param expr String representation of the expression in the assertion.
 		 */
 		virtual void formatPassedCheck(int line, std::string expr) {}
 		
@@ -510,6 +5061,18 @@ namespace litest
 		 */
 		virtual void formatFailedCheck(int line, std::string expr) {}
 		
+		/**
+		 Called when a check assertion failed and the values of its operands are known.
+		 Calls formatFailedCheck() with the values appended unless overridden.
+		 @param line Line number where the assertion was defined.
+		 @param expr String representation of the expression in the assertion.
+		 @param values String representation of the operand values, e.g. `a=7, b=3`.
+		 */
+		virtual void formatFailedCheckValues(int line, std::string expr, std::string values)
+		{
+			this->formatFailedCheck(line, expr + " with " + values);
+		}
+		
 		/**
 		 Called when an equal assertion failed.
 		 Does nothing unless overridden.
@@ -536,6 +5099,48 @@ namespace litest
 		 */
 		virtual void formatManualFailure(int line, std::string reason) {}
 		
+		/**
+		 Called before the test footer for each assertion that failed more often than TestSuite::failureReportLimit.
+		 Does nothing unless overridden.
+		 @param line Line number where the assertion was defined.
+		 @param expr String representation of the expression in the assertion.
+		 @param count Number of failures that were not reported.
+		 @param firstIteration Evaluation number (within the test) of the first failure that was not reported.
+		 */
+		virtual void formatSuppressedFailures(int line, std::string expr, long long count, long long firstIteration) {}
+		
+		/**
+		 Called before the test footer for each sampled assertion reached in the test.
+		 Does nothing unless overridden.
+		 @param line Line number where the assertion was defined.
+		 @param expr String representation of the expression in the assertion.
+		 @param evaluations Number of times the assertion was evaluated.
+		 @param skips Number of times the assertion was skipped.
+		 */
+		virtual void formatSampledAssertion(int line, std::string expr, long long evaluations, long long skips) {}
+		
+		/**
+		 Called before the first benchmark of a test suite run, with the conditions it runs under.
+		 Does nothing unless overridden.
+		 @param env The inspected benchmark environment.
+		 */
+		virtual void formatBenchmarkEnvironment(bench::Environment const& env) {}
+		
+		/**
+		 Called after formatTestSuiteStart() if the TestSuite was calibrated.
+		 Does nothing unless overridden.
+		 @param cal Machine calibration results.
+		 */
+		virtual void formatCalibration(bench::Calibration const& cal) {}
+		
+		/**
+		 Called when a benchmark completed.
+		 Does nothing unless overridden.
+		 @param line Line number where the benchmark was defined.
+		 @param result Timing of the benchmark.
+		 */
+		virtual void formatBenchmark(int line, bench::Result const& result) {}
+		
 		/**@}*/
 		
 		/**
@@ -570,112 +5175,788 @@ namespace litest
 			else return "???";
 		}
 		
+		/** Write buffered output to the stream's destination. */
+		inline void flush()
+		{
+			this->s.flush();
+		}
+		
 	protected:
 		
 		/** Output stream used by this formatter. */
 		std::ostream &s;
 	};
 	
+	namespace internal
+	{
+		/** Formatter that reports nothing, for runs of tests that are not reported. */
+		class QuietFormatter : public TestResultFormatter
+		{
+		public:
+			
+			/**
+			 Constructor.
+			 @param ostr Output stream, which is not written to.
+			 */
+			QuietFormatter(std::ostream &ostr)
+			: TestResultFormatter(ostr) {}
+		};
+	}
+	
 	/** A collection of tests. */
 	class TestSuite
 	{
 	public:
 		
-		/** Behaviour of a test suite when a assertion fails. */
-		enum class Mode
+		/** Behaviour of a test suite when a assertion fails. */
+		enum class Mode
+		{
+			Continue, /**< The test will continue without interruption. */
+			Throw /**< AssertionFailureException will be thrown. (Useful for debugging.) */
+		};
+		
+		/** Whether the standard output and standard error of tests are captured, and when they are reported. */
+		enum class Capture
+		{
+			Off, /**< Tests write to the standard streams of the process. */
+			OnFailure, /**< Output is captured, and reported for failed and aborted tests. */
+			Always /**< Output is captured, and reported for every test that wrote any. */
+		};
+		
+		/** What happens when a test crashes with a fatal signal, such as a segmentation fault. */
+		enum class CrashHandling
+		{
+			Off, /**< The process dies as usual. */
+			Report, /**< The last words of the test are written and the report is closed, then the process dies. */
+			Resume /**< The last words are written, then the binary is re-executed to continue after the crashed test. Linux only; elsewhere the same as Report. */
+		};
+		
+		/** Constructor.
+		 @param name Identifying name for this suite.
+		 */
+		TestSuite(std::string name)
+		: suiteName(name) {}
+		
+		/**
+		 Add a test to this TestSuite.
+		 @param name Short description of the test.
+		 @param func Payload of the test.
+		 @param file @optional File name where the test was defined.
+		 @param line @optional Line where the test was defined.
+		 */
+		inline void addTest(std::string name, TestFunc func, std::string file = "N/A", int line = 0)
+		{
+			this->tests.emplace_back(file, name, func, this->tests.size()+1);
+			this->tests.back().line = line;
+		}
+		
+		/**
+		 Declare that a test is only worth running if another test passed, e.g. an expensive end-to-end test
+		 that depends on a cheap unit test of the same component. Tests run after the tests they depend on,
+		 and are skipped if one of them failed or was skipped. Dependencies on tests that are not selected
+		 for a run are ignored; dependencies on tests that do not exist make the test be skipped.
+		 @param test Name of the dependent test.
+		 @param dependency Name of the test it depends on.
+		 */
+		inline void addDependency(std::string test, std::string dependency)
+		{
+			for (Test &t : this->tests)
+				if (t.name == test) t.dependencies.push_back(dependency);
+		}
+		
+#ifdef LITEST_COROUTINES
+		/**
+		 Add an async test to this TestSuite.
+		 Consecutive async tests are run interleaved on one event loop, so that tests waiting for I/O and timers
+		 take about as long together as the slowest of them. Their reports are written in order.
+		 Output capture does not apply to async tests.
+		 @param name Short description of the test.
+		 @param func Coroutine function returning the test Task.
+		 @param file @optional File name where the test was defined.
+		 @param line @optional Line where the test was defined.
+		 */
+		inline void addAsyncTest(std::string name, std::function<async::Task(TestSuite&)> func, std::string file = "N/A", int line = 0)
+		{
+			this->tests.emplace_back(file, name, [func](TestSuite &suite) { async::EventLoop::current()->spawn(func(suite)); }, this->tests.size()+1);
+			this->tests.back().line = line;
+			this->tests.back().async = true;
+		}
+#endif
+		
+		/**
+		 Runs the Test s in this TestSuite.
+		 @tparam TestResultFormatterType The formatter type to use for output. Must be a subclass of TestResultFormatter.
+		 @param out Stream to direct the output to.
+		 @param testIdx Indexes of the tests to run.
+		 @param mode @optional Action to take if an assertion fails.
+		 */
+		template<typename TestResultFormatterType>
+		inline void runSome(std::ostream &out, std::vector<int> testIdx, Mode mode = Mode::Continue)
+		{
+			const char *listSites = std::getenv(LITEST_LIST_SITES_ENV);
+			if (listSites && *listSites)
+			{
+				for (AssertionSite const& site : this->assertionSites())
+					out << site.file << ":" << site.line << "\t" << site.expr << std::endl;
+				return;
+			}
+			
+			this->mode = mode;
+			
+			// After a crash, runs before the crashed one have been reported by the crashed process
+			int run = ++internal::runSerial();
+			int resumeAfter = -1;
+#ifdef LITEST_POSIX
+			internal::ResumePoint const& resume = internal::resumePoint();
+			if (run < resume.run) return;
+			if (run == resume.run) resumeAfter = resume.position;
+#endif
+			
+			// Test output must not end up in a report written to a redirected standard stream,
+			// and after a crash the handler has to find the unwritten part of the report
+			std::unique_ptr<internal::FdStreamBuf> reportBuf;
+			std::unique_ptr<std::ostream> reportStream;
+#ifdef LITEST_POSIX
+			int outFd = internal::streamFd(out);
+			if ((this->captureOutput != Capture::Off || this->crashHandling != CrashHandling::Off) && (outFd == 1 || outFd == 2))
+			{
+				out.flush();
+				reportBuf.reset(new internal::FdStreamBuf(::fcntl(outFd, F_DUPFD_CLOEXEC, 0), true));
+				reportStream.reset(new std::ostream(reportBuf.get()));
+			}
+#endif
+			
+			// With a checkpoint journal, the part of the report written for each test is saved with it
+			std::string journalPath = this->checkpointFile;
+			const char *journalEnv = std::getenv(LITEST_CHECKPOINT_ENV);
+			if (journalPath.empty() && journalEnv) journalPath = journalEnv;
+			std::unique_ptr<internal::RecordingStreamBuf> recordBuf;
+			std::unique_ptr<std::ostream> recordStream;
+			if (!journalPath.empty())
+			{
+				const char *resumeEnv = std::getenv(LITEST_CHECKPOINT_RESUME_ENV);
+				internal::checkpointJournal().open(journalPath, this->resumeFromCheckpoint || (resumeEnv && *resumeEnv));
+				recordBuf.reset(new internal::RecordingStreamBuf((reportStream ? *reportStream : out).rdbuf()));
+				recordStream.reset(new std::ostream(recordBuf.get()));
+			}
+			std::ostream &report = recordStream ? *recordStream : reportStream ? *reportStream : out;
+			
+			this->output = new TestResultFormatterType(report);
+			this->chooseSeed();
+			this->totalStats_ = TestStats();
+			this->carriedSites_.clear();
+			for (internal::Site *site : internal::allSites()) site->resetTotals();
+			this->benchmarkEnvironment_.reset();
+			this->calibration_.reset();
+			
+#ifdef LITEST_POSIX
+			internal::CrashState &crash = internal::crashState();
+			if (this->crashHandling != CrashHandling::Off)
+			{
+				internal::installCrashHandler(this->crashHandling == CrashHandling::Resume);
+				crash.run = run;
+				crash.totals = &this->totalStats_;
+				crash.reportBuf = reportBuf ? reportBuf.get() : dynamic_cast<internal::FdStreamBuf*>(out.rdbuf());
+				crash.reportFd = crash.reportBuf ? crash.reportBuf->fd() : -1;
+				std::string epilogue = this->output->crashEpilogue();
+				std::strncpy(crash.epilogue, epilogue.c_str(), sizeof(crash.epilogue) - 1);
+			}
+#endif
+#ifdef LITEST_SANITIZER_HOOKS
+			this->watchSanitizers();
+#endif
+			
+			auto startTime = this->startTime_ = TimeType::clock::now();
+			if (resumeAfter < 0)
+			{
+				this->output->formatTestSuiteStart(*this);
+				if (this->calibrate)
+				{
+					this->calibration_.reset(new bench::Calibration(bench::calibrate()));
+					this->output->formatCalibration(*this->calibration_);
+				}
+				this->reportPipe_.suiteStart(this->suiteName);
+			}
+			
+			const char *runsEnv = std::getenv(LITEST_DETERMINISM_RUNS_ENV);
+			int determinismRuns = runsEnv && *runsEnv ? std::atoi(runsEnv) : this->determinismRuns;
+			
+			// Run each test in turn, after the tests it depends on
+			testIdx = this->orderByDependencies(testIdx, this->dependencyCycles_);
+			this->outcomes_.clear();
+			for (int index : testIdx) if (index >= 0 && index < (int)this->tests.size()) this->outcomes_[this->tests[index].name];
+			for (size_t i = 0; i < testIdx.size(); i++)
+			{
+				int index = testIdx[i];
+				if (!(index >= 0 && index < (int)this->tests.size())) continue;
+#ifdef LITEST_POSIX
+				if (resumeAfter >= 0)
+				{
+					// Skip to the crashed test, keeping the outcomes of the tests before it, and report it with the stats it had
+					if ((int)i < resumeAfter)
+					{
+						char outcome = i < resume.outcomes.size() ? resume.outcomes[i] : '?';
+						this->outcomes_[this->tests[index].name] = outcome == 'p' ? "passed" : outcome == 'f' ? "failed" : outcome == 's' ? "skipped" : "run before the crash";
+						continue;
+					}
+					auto test = this->tests[index];
+					this->startTest();
+					this->totalStats_ = resume.totals;
+					this->stats_[counter] = resume.current;
+					test.aborted = true;
+					this->output->formatAbortedTest(resume.line, "Crashed with " + std::string{internal::signalName(resume.signal)});
+					this->finishTest(test);
+					resumeAfter = -1;
+					continue;
+				}
+#endif
+				if (recordBuf)
+				{
+					// Completed before the run was interrupted
+					internal::CheckpointRecord const* record = internal::checkpointJournal().find(this->suiteName, run, (int)i, this->tests[index].name);
+					if (record)
+					{
+						this->replayTest(this->tests[index], *record, report);
+						continue;
+					}
+				}
+				std::string skipReason = this->unmetDependency(this->tests[index]);
+				if (!skipReason.empty())
+				{
+					this->outcomes_[this->tests[index].name] = "skipped";
+					this->totalStats_.skippedTests++;
+					this->output->formatSkippedTest(this->tests[index], skipReason);
+					continue;
+				}
+#ifdef LITEST_COROUTINES
+				if (this->tests[index].async)
+				{
+					// Interleave with the async tests that directly follow, unless they wait for others to pass
+					std::vector<int> batch;
+					for (; i < testIdx.size() && testIdx[i] >= 0 && testIdx[i] < (int)this->tests.size() && this->tests[testIdx[i]].async
+						&& (batch.empty() || this->tests[testIdx[i]].dependencies.empty()); i++)
+						batch.push_back(testIdx[i]);
+					i--;
+					this->runAsync<TestResultFormatterType>(batch, report);
+					continue;
+				}
+#endif
+				auto test = this->tests[index];
+				
+				std::map<internal::Site*, AssertionSite> sitesBefore;
+				if (recordBuf)
+				{
+					this->output->flush();
+					recordBuf->start();
+					sitesBefore = siteCounters();
+				}
+				this->startTest();
+				this->output->formatTestHeader(test);
+				
+				this->output->flush();
+				std::unique_ptr<internal::OutputRedirect> redirect;
+				if (this->captureOutput != Capture::Off) redirect.reset(new internal::OutputRedirect());
+#ifdef LITEST_POSIX
+				// Kept for the crash handler and sanitizer reports
+				std::strncpy(crash.testName, test.name.c_str(), sizeof(crash.testName) - 1);
+				crash.testIndex = test.index;
+				crash.testPosition = (int)i;
+				for (size_t j = 0; j < i && j < sizeof(crash.outcomes) - 1; j++)
+					if (testIdx[j] >= 0 && testIdx[j] < (int)this->tests.size())
+					{
+						std::string const& outcome = this->outcomes_[this->tests[testIdx[j]].name];
+						crash.outcomes[j] = outcome.empty() ? '?' : outcome[0];
+					}
+				crash.outcomes[std::min(i, sizeof(crash.outcomes) - 1)] = '\0';
+				crash.lastLine = 0;
+				crash.current = &this->stats_[counter];
+				crash.savedOut = redirect ? redirect->savedOut() : -1;
+				crash.savedErr = redirect ? redirect->savedErr() : -1;
+				crash.captureFd = redirect ? redirect->fd() : -1;
+				crash.inTest = 1;
+#endif
+				this->currentTest_ = &test;
+				internal::randomState().testSeed = internal::mixSeed(internal::randomState().runSeed, test.index);
+				std::unique_ptr<internal::AssertionTrace> trace;
+				if (determinismRuns > 1) trace.reset(new internal::AssertionTrace());
+				this->trace_ = trace.get();
+				
+				try
+				{
+					// Run the test
+					auto testStartTime = TimeTypeHiRes::clock::now();
+					test.func(*this);
+					auto endTime = TimeTypeHiRes::clock::now();
+					test.duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - testStartTime).count() / 1e6;
+				}
+				catch (...)
+				{
+					this->abortTest(test, std::current_exception());
+				}
+#ifdef LITEST_POSIX
+				crash.inTest = 0;
+				crash.savedOut = crash.savedErr = crash.captureFd = -1;
+#endif
+				this->currentTest_ = nullptr;
+				this->trace_ = nullptr;
+#ifdef LITEST_SANITIZER_HOOKS
+				this->reportSanitizerFindings(test);
+#endif
+				
+				if (redirect)
+				{
+					this->output->flush();
+					test.output = redirect->finish();
+					bool failed = test.aborted || this->currentTestStats().fails > 0;
+					if (test.output && test.output->size() > 0 && (failed || this->captureOutput == Capture::Always))
+						this->output->formatCapturedOutput(test, *test.output);
+				}
+				
+				if (trace) this->checkDeterminism(test, *trace, determinismRuns);
+				this->finishTest(test);
+				
+				if (recordBuf)
+				{
+					this->output->flush();
+					internal::CheckpointRecord record;
+					record.suite = this->suiteName;
+					record.run = run;
+					record.position = (int)i;
+					record.name = test.name;
+					record.outcome = this->outcomes_[test.name];
+					record.stats = this->currentTestStats();
+					record.report = recordBuf->stop();
+					record.sites = siteChanges(sitesBefore);
+					internal::checkpointJournal().append(record);
+				}
+			}
+			
+			this->endTime = TimeType::clock::now();
+			this->duration = std::chrono::duration_cast<std::chrono::microseconds>(this->endTime - startTime).count() / 1e6;
+			this->output->formatAssertionSites(this->assertionSites());
+			this->output->formatTestSuiteEnd(*this);
+			this->reportPipe_.suiteEnd(this->totalStats_.passes, this->totalStats_.fails, this->duration);
+			this->output->flush();
+#ifdef LITEST_POSIX
+			if (this->crashHandling != CrashHandling::Off) internal::uninstallCrashHandler();
+#endif
+#ifdef LITEST_SANITIZER_HOOKS
+			internal::runningSuite() = nullptr;
+#endif
+			delete output;
+		}
+		
+#ifdef LITEST_SANITIZER_HOOKS
+		/**
+		 Attribute sanitizer reports to the running test. If a sanitizer runtime is linked in, registers a callback
+		 that completes the report when the sanitizer ends the process.
+		 */
+		inline void watchSanitizers()
+		{
+			internal::runningSuite() = this;
+			internal::sanitizerReports().take();
+			if (__sanitizer_set_death_callback) __sanitizer_set_death_callback(&TestSuite::sanitizerDeath);
+		}
+		
+		/**
+		 Report the sanitizer findings of a test as aborted-test events.
+		 @param test The test, marked as aborted if there were findings.
+		 */
+		inline void reportSanitizerFindings(Test &test)
+		{
+			for (std::string summary : internal::sanitizerReports().take())
+			{
+				if (summary.compare(0, 9, "SUMMARY: ") == 0) summary.erase(0, 9);
+				test.aborted = true;
+				this->output->formatAbortedTest(internal::crashState().lastLine, summary);
+			}
+		}
+		
+		/**
+		 Called by the sanitizer runtime before it ends the process after a report. Reports the findings as
+		 aborting the running test, and completes the report of the run as if it ended after that test.
+		 Output captured from the test, which holds the sanitizer report, is copied to the original standard error.
+		 */
+		static inline void sanitizerDeath()
+		{
+			TestSuite *suite = internal::runningSuite();
+			if (!suite || !suite->output) return;
+			internal::runningSuite() = nullptr;
+			
+			internal::releaseCapturedOutput();
+			if (suite->currentTest_)
+			{
+				suite->reportSanitizerFindings(*suite->currentTest_);
+				suite->finishTest(*suite->currentTest_);
+			}
+			suite->endTime = TimeType::clock::now();
+			suite->duration = std::chrono::duration_cast<std::chrono::microseconds>(suite->endTime - suite->startTime_).count() / 1e6;
+			suite->output->formatAssertionSites(suite->assertionSites());
+			suite->output->formatTestSuiteEnd(*suite);
+			suite->reportPipe_.suiteEnd(suite->totalStats_.passes, suite->totalStats_.fails, suite->duration);
+			suite->output->flush();
+		}
+#endif
+		
+		/**
+		 Runs the Test s in this TestSuite.
+		 @tparam TestResultFormatterType The formatter type to use for output. Must be a subclass of TestResultFormatter.
+		 @param out Stream to direct the output to.
+		 @param mode @optional Action to take if an assertion fails.
+		 */
+		template<typename TestResultFormatterType>
+		inline void run(std::ostream &out, Mode mode = Mode::Continue)
+		{
+			std::vector<int> allIndexes(this->tests.size());
+			iota(allIndexes.begin(), allIndexes.end(), 0);
+			this->runSome<TestResultFormatterType>(out, allIndexes, mode);
+		}
+		
+		/**
+		 Report the exception that ended a test.
+		 @param test The test, marked as aborted.
+		 @param exception Exception thrown out of the test function.
+		 */
+		inline void abortTest(Test &test, std::exception_ptr exception)
+		{
+			test.aborted = true;
+			try
+			{
+				std::rethrow_exception(exception);
+			}
+			catch (TestAbortException &e)
+			{
+				output->formatAbortedTest(e.lineNumber, e.what());
+			}
+			catch (std::exception &e)
+			{
+				if (this->trace_) this->trace_->event(nullptr, false);
+				this->traceValue(e.what());
+				output->formatAbortedTest(0, "Uncaught exception: " + std::string{e.what()});
+			}
+			catch (...)
+			{
+				if (this->trace_) this->trace_->event(nullptr, false);
+				output->formatAbortedTest(0, "Uncaught exception outside of assertion.");
+			}
+		}
+		
+		/**
+		 Report the per-site summaries and the footer of a test that has run.
+		 @param test The test.
+		 */
+		inline void finishTest(Test const& test)
+		{
+			for (internal::Site *site : this->suppressedSites_)
+				this->output->formatSuppressedFailures(site->line, site->expr, site->fails - this->failureReportLimit, site->firstSuppressed);
+			this->suppressedSites_.clear();
+			for (internal::Site *site : this->sampledSites_)
+				this->output->formatSampledAssertion(site->line, site->expr, site->evaluations, site->skips);
+			this->sampledSites_.clear();
+			
+			if (test.aborted)
+			{
+				this->stats_[counter].aborted = 1;
+				this->totalStats_.aborted++;
+			}
+			this->outcomes_[test.name] = test.aborted || this->currentTestStats().fails > 0 ? "failed" : "passed";
+			if (this->outcomes_[test.name] == "failed" && internal::randomState().usedSerial == internal::testSerial())
+				this->output->formatRandomSeed(internal::randomState().runSeed);
+			this->output->formatTestFooter(test, this->currentTestStats());
+			this->reportPipe_.testEnd(test, this->currentTestStats().passes, this->currentTestStats().fails);
+		}
+		
+#ifdef LITEST_COROUTINES
+		/**
+		 Run async tests interleaved on an event loop.
+		 Each test reports to its own formatter, writing to a buffer that is copied to the report when all tests
+		 completed. The event loop switches the current test, formatter and assertion site state of the suite
+		 whenever it resumes a coroutine of another test.
+		 @tparam TestResultFormatterType The formatter type to use for output.
+		 @param batch Indexes of the tests.
+		 @param out Stream the report is written to.
+		 */
+		template<typename TestResultFormatterType>
+		inline void runAsync(std::vector<int> const& batch, std::ostream &out)
+		{
+			struct Slot
+			{
+				Test test;
+				int counter;
+				unsigned long serial;
+				std::stringstream buffer;
+				std::unique_ptr<TestResultFormatter> output;
+				std::vector<internal::Site*> suppressedSites;
+				std::vector<internal::Site*> sampledSites;
+				TimeTypeHiRes startTime;
+			};
+			std::vector<std::unique_ptr<Slot>> slots;
+			TestResultFormatter *mainOutput = this->output;
+			
+			// While a slot is active, its site lists are swapped into the suite
+			int active = -1;
+			auto switchTo = [&](int owner)
+			{
+				if (owner == active) return;
+				if (active >= 0)
+				{
+					this->suppressedSites_.swap(slots[active]->suppressedSites);
+					this->sampledSites_.swap(slots[active]->sampledSites);
+				}
+				Slot &slot = *slots[owner];
+				this->counter = slot.counter;
+				this->output = slot.output.get();
+				internal::testSerial() = slot.serial;
+				internal::randomState().testSeed = internal::mixSeed(internal::randomState().runSeed, slot.test.index);
+				this->suppressedSites_.swap(slot.suppressedSites);
+				this->sampledSites_.swap(slot.sampledSites);
+				active = owner;
+			};
+			
+			async::EventLoop loop;
+			loop.onSwitch = switchTo;
+			loop.onFinish = [&](int owner, std::exception_ptr exception)
+			{
+				Slot &slot = *slots[owner];
+				if (exception) this->abortTest(slot.test, exception);
+				else slot.test.duration = std::chrono::duration_cast<std::chrono::microseconds>(TimeTypeHiRes::clock::now() - slot.startTime).count() / 1e6;
+			};
+			
+			async::EventLoop *previous = async::EventLoop::current();
+			async::EventLoop::current() = &loop;
+			for (int index : batch)
+			{
+				slots.emplace_back(new Slot{this->tests[index]});
+				Slot &slot = *slots.back();
+				this->startTest();
+				slot.counter = this->counter;
+				slot.serial = internal::testSerial();
+				slot.output.reset(new TestResultFormatterType(slot.buffer));
+				switchTo((int)slots.size() - 1);
+				this->output->formatTestHeader(slot.test);
+				slot.startTime = TimeTypeHiRes::clock::now();
+				loop.setOwner(active);
+				try { this->tests[index].func(*this); }
+				catch (...) { this->abortTest(slot.test, std::current_exception()); }
+			}
+			async::EventLoop::current() = previous;
+			loop.run();
+			
+			for (size_t i = 0; i < slots.size(); i++)
+			{
+				switchTo((int)i);
+				this->finishTest(slots[i]->test);
+				this->output->flush();
+				out << slots[i]->buffer.str();
+			}
+			this->output = mainOutput;
+		}
+#endif
+		
+		/**
+		 Choose the seed of a run: from the `LITEST_SEED` environment variable, else seed, else at random.
+		 A seed chosen at random is put in the environment as LITEST_AUTO_SEED_ENV, so that later runs in the process,
+		 processes it starts and the process re-executed after a crash use it too, unless they have a seed of their own.
+		 */
+		inline void chooseSeed()
+		{
+			const char *env = std::getenv(LITEST_SEED_ENV);
+			const char *autoEnv = std::getenv(LITEST_AUTO_SEED_ENV);
+			uint64_t seed = this->seed;
+			if (env && *env) seed = std::strtoull(env, nullptr, 0);
+			else if (seed == 0 && autoEnv && *autoEnv) seed = std::strtoull(autoEnv, nullptr, 0);
+			else if (seed == 0)
+			{
+				std::random_device device;
+				seed = ((uint64_t)device() << 32) ^ device() ^ (uint64_t)TimeTypeHiRes::clock::now().time_since_epoch().count();
+#ifdef LITEST_POSIX
+				std::stringstream ss;
+				ss << "0x" << std::hex << seed;
+				::setenv(LITEST_AUTO_SEED_ENV, ss.str().c_str(), 1);
+#endif
+			}
+			internal::randomState().runSeed = seed;
+		}
+		
+		/**
+		 Run a test again, without reporting it, and compare the assertions of each run with those of the reported run.
+		 The first difference is reported, and counted as a failed assertion. Stats and assertion site counters of
+		 the extra runs are discarded.
+		 @param test The test, after its reported run.
+		 @param first Trace of the reported run.
+		 @param runs Number of runs, including the reported one.
+		 */
+		inline void checkDeterminism(Test const& test, internal::AssertionTrace &first, int runs)
 		{
-			Continue, /**< The test will continue without interruption. */
-			Throw /**< AssertionFailureException will be thrown. (Useful for debugging.) */
-		};
+			first.finish();
+			std::vector<std::pair<internal::Site*, internal::Site>> sites;
+			for (internal::Site *site : internal::allSites()) sites.emplace_back(site, *site);
+			int reportedCounter = this->counter;
+			size_t statsSize = this->stats_.size();
+			TestStats totals = this->totalStats_;
+			std::vector<internal::Site*> suppressedSites = this->suppressedSites_, sampledSites = this->sampledSites_;
+			TestResultFormatter *output = this->output;
+			std::ostream discard(nullptr);
+			internal::QuietFormatter quiet(discard);
+			
+			std::string difference;
+			for (int run = 2; run <= runs && difference.empty(); run++)
+			{
+				internal::AssertionTrace trace(&first);
+				Test copy = test;
+				this->output = &quiet;
+				this->trace_ = &trace;
+				this->startTest();
+				std::unique_ptr<internal::OutputRedirect> redirect;
+				if (this->captureOutput != Capture::Off) redirect.reset(new internal::OutputRedirect());
+				try { copy.func(*this); }
+				catch (...) { this->abortTest(copy, std::current_exception()); }
+				if (redirect) redirect->finish();
+				this->trace_ = nullptr;
+				trace.finish();
+				difference = trace.difference(run);
+			}
+			
+			this->output = output;
+			this->counter = reportedCounter;
+			this->stats_.resize(statsSize);
+			this->totalStats_ = totals;
+			this->suppressedSites_ = suppressedSites;
+			this->sampledSites_ = sampledSites;
+			for (internal::Site *site : internal::allSites())
+			{
+				auto saved = std::find_if(sites.begin(), sites.end(), [&](std::pair<internal::Site*, internal::Site> const& s) { return s.first == site; });
+				bool listed = site->listed;
+				*site = saved != sites.end() ? saved->second : internal::Site(site->file, site->line, site->expr);
+				site->listed = listed;
+			}
+			
+			if (difference.empty()) return;
+			this->failed();
+			this->stats_[counter].nondeterministic = 1;
+			this->totalStats_.nondeterministic++;
+			this->output->formatNondeterminism(difference);
+		}
 		
-		/** Constructor.
-		 @param name Identifying name for this suite.
+		/**
+		 Report a test completed before the run was interrupted, from its checkpoint record: its part of the
+		 report is written again, and its stats and assertion site counters are added to those of the run.
+		 @param test The test.
+		 @param record Record of the test.
+		 @param report Stream the report is written to.
 		 */
-		TestSuite(std::string name)
-		: suiteName(name) {}
+		inline void replayTest(Test const& test, internal::CheckpointRecord const& record, std::ostream &report)
+		{
+			this->startTest();
+			this->stats_[counter] = record.stats;
+			this->totalStats_.passes += record.stats.passes;
+			this->totalStats_.fails += record.stats.fails;
+			this->totalStats_.sampled += record.stats.sampled;
+			this->totalStats_.skips += record.stats.skips;
+			this->totalStats_.aborted += record.stats.aborted;
+			this->totalStats_.nondeterministic += record.stats.nondeterministic;
+			this->carriedSites_.insert(this->carriedSites_.end(), record.sites.begin(), record.sites.end());
+			this->outcomes_[test.name] = record.outcome;
+			this->output->flush();
+			report << record.report;
+			this->reportPipe_.testEnd(test, record.stats.passes, record.stats.fails);
+		}
 		
 		/**
-		 Add a test to this TestSuite.
-		 @param name Short description of the test.
-		 @param func Payload of the test.
-		 @param file @optional File name where the test was defined.
+		 Take the run counters of all assertion sites, to find the ones a test changes.
+		 @return Counters by site.
 		 */
-		inline void addTest(std::string name, TestFunc func, std::string file = "N/A")
+		static inline std::map<internal::Site*, AssertionSite> siteCounters()
 		{
-			this->tests.emplace_back(file, name, func, this->tests.size()+1);
+			std::map<internal::Site*, AssertionSite> counters;
+			for (internal::Site *site : internal::allSites())
+				counters[site] = {site->file, site->line, site->expr, site->hits, site->totalPasses, site->totalFails, site->estimatedNanoseconds()};
+			return counters;
 		}
 		
 		/**
-		 Runs the Test s in this TestSuite.
-		 @tparam TestResultFormatterType The formatter type to use for output. Must be a subclass of TestResultFormatter.
-		 @param out Stream to direct the output to.
-		 @param testIdx Indexes of the tests to run.
-		 @param mode @optional Action to take if an assertion fails.
+		 Find what a test added to the run counters of assertion sites.
+		 @param before Counters from siteCounters() before the test.
+		 @return The sites reached by the test, with the differences.
 		 */
-		template<typename TestResultFormatterType>
-		inline void runSome(std::ostream &out, std::vector<int> testIdx, Mode mode = Mode::Continue)
+		static inline std::vector<AssertionSite> siteChanges(std::map<internal::Site*, AssertionSite> const& before)
 		{
-			this->mode = mode;
-			this->output = new TestResultFormatterType(out);
-			this->totalStats_ = TestStats();
-			
-			auto startTime = TimeType::clock::now();
-			this->output->formatTestSuiteStart(*this);
-			
-			// Run each test in turn
-			for (int index : testIdx)
+			std::vector<AssertionSite> changes;
+			for (auto const& after : siteCounters())
 			{
-				if (!(index >= 0 && index < (int)this->tests.size())) continue;
-				auto test = this->tests[index];
-				
-				this->startTest();
-				this->output->formatTestHeader(test);
-				
-				try
-				{
-					// Run the test
-					auto testStartTime = TimeTypeHiRes::clock::now();
-					test.func(*this);
-					auto endTime = TimeTypeHiRes::clock::now();
-					test.duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - testStartTime).count() / 1e6;
-				}
-				catch (TestAbortException &e)
+				AssertionSite site = after.second;
+				auto previous = before.find(after.first);
+				if (previous != before.end())
 				{
-					test.aborted = true;
-					output->formatAbortedTest(e.lineNumber, e.what());
-				}
-				catch (std::exception &e)
-				{
-					test.aborted = true;
-					output->formatAbortedTest(0, "Uncaught exception: " + std::string{e.what()});
-				}
-				catch (...)
-				{
-					test.aborted = true;
-					output->formatAbortedTest(0, "Uncaught exception outside of assertion.");
+					site.hits -= previous->second.hits;
+					site.passes -= previous->second.passes;
+					site.fails -= previous->second.fails;
+					site.nanoseconds -= previous->second.nanoseconds;
 				}
-				
-				this->output->formatTestFooter(test, this->currentTestStats());
+				if (site.hits > 0) changes.push_back(site);
 			}
+			return changes;
+		}
+		
+		/**
+		 Order tests so that each runs after the tests it depends on, keeping the given order where possible.
+		 Tests in a dependency cycle keep their place; they are skipped when run.
+		 @param testIdx Indexes of the tests to run.
+		 @param cycles Set to the dependencies that close a cycle, as (test, dependency) pairs of names.
+		 @return The indexes in the order to run them.
+		 */
+		inline std::vector<int> orderByDependencies(std::vector<int> const& testIdx, std::set<std::pair<std::string, std::string>> &cycles) const
+		{
+			std::map<std::string, size_t> position;
+			for (size_t i = 0; i < testIdx.size(); i++)
+				if (testIdx[i] >= 0 && testIdx[i] < (int)this->tests.size()) position[this->tests[testIdx[i]].name] = i;
 			
-			this->endTime = TimeType::clock::now();
-			this->duration = std::chrono::duration_cast<std::chrono::microseconds>(this->endTime - startTime).count() / 1e6;
-			this->output->formatTestSuiteEnd(*this);
-			delete output;
+			// Depth-first, visiting the dependencies of each test before the test itself;
+			// reaching a test that is still being visited closes a cycle
+			enum class State : char { Unvisited, Visiting, Visited };
+			std::vector<int> order;
+			std::vector<State> state(testIdx.size(), State::Unvisited);
+			cycles.clear();
+			std::function<void(size_t)> visit = [&](size_t i)
+			{
+				if (state[i] != State::Unvisited) return;
+				state[i] = State::Visiting;
+				int index = testIdx[i];
+				if (index >= 0 && index < (int)this->tests.size())
+					for (std::string const& dependency : this->tests[index].dependencies)
+					{
+						auto found = position.find(dependency);
+						if (found == position.end()) continue;
+						if (state[found->second] == State::Visiting) cycles.insert({ this->tests[index].name, dependency });
+						else visit(found->second);
+					}
+				state[i] = State::Visited;
+				order.push_back(index);
+			};
+			for (size_t i = 0; i < testIdx.size(); i++) visit(i);
+			return order;
 		}
 		
 		/**
-		 Runs the Test s in this TestSuite.
-		 @tparam TestResultFormatterType The formatter type to use for output. Must be a subclass of TestResultFormatter.
-		 @param out Stream to direct the output to.
-		 @param mode @optional Action to take if an assertion fails.
+		 Find a reason not to run a test, as one of its dependencies did not pass.
+		 @param test The test, whose dependencies have run unless they are in a cycle.
+		 @return Reason to skip the test, or an empty string to run it.
 		 */
-		template<typename TestResultFormatterType>
-		inline void run(std::ostream &out, Mode mode = Mode::Continue)
+		inline std::string unmetDependency(Test const& test) const
 		{
-			std::vector<int> allIndexes(this->tests.size());
-			iota(allIndexes.begin(), allIndexes.end(), 0);
-			this->runSome<TestResultFormatterType>(out, allIndexes, mode);
+			for (std::string const& dependency : test.dependencies)
+			{
+				if (this->dependencyCycles_.count({ test.name, dependency })) return "dependency " + dependency + " is in a cycle with this test";
+				auto outcome = this->outcomes_.find(dependency);
+				if (outcome == this->outcomes_.end())
+				{
+					bool exists = std::any_of(this->tests.begin(), this->tests.end(), [&](Test const& t) { return t.name == dependency; });
+					if (!exists) return "dependency " + dependency + " does not exist";
+				}
+				else if (outcome->second.empty()) return "dependency " + dependency + " has not run";
+				else if (outcome->second == "failed" || outcome->second == "skipped") return "dependency " + dependency + " " + outcome->second;
+			}
+			return "";
 		}
 		
 		/**
@@ -685,33 +5966,199 @@ namespace litest
 		inline void startTest()
 		{
 			counter++;
+			internal::testSerial()++;
 			this->stats_.push_back({});
 		}
 		
 		/**
 		 Register a passed assertion.
 		 Updates current and total TestStats.
+		 @param site @optional Site of the assertion, if known.
 		 @return AssertionResult::Passed.
 		 */
-		inline AssertionResult passed()
+		inline AssertionResult passed(internal::Site *site = nullptr)
 		{
 			this->totalStats_.passes++;
 			this->stats_[counter].passes++;
+			if (this->trace_) this->trace_->event(site, true);
 			return AssertionResult::Passed;
 		}
 		
 		/**
 		 Register a failed assertion.
 		 Updates current and total TestStats.
+		 @param site @optional Site of the assertion, if known.
 		 @return AssertionResult::Failed.
 		 */
-		inline AssertionResult failed()
+		inline AssertionResult failed(internal::Site *site = nullptr)
 		{
 			this->totalStats_.fails++;
 			this->stats_[counter].fails++;
+			if (this->trace_) this->trace_->event(site, false);
 			return AssertionResult::Failed;
 		}
 		
+		/**
+		 Whether assertions are traced to check that the test is deterministic; see determinismRuns.
+		 Assertion functions then describe the values of failed assertions even if the failure is not reported.
+		 */
+		inline bool tracing() const
+		{
+			return this->trace_ != nullptr;
+		}
+		
+		/**
+		 Add the described values of the last assertion to its trace event, if tracing.
+		 @param value Description of the values.
+		 */
+		inline void traceValue(std::string const& value)
+		{
+			if (this->trace_) this->trace_->value(value);
+		}
+		
+		/**
+		 Register a passed assertion at a site.
+		 Updates current and total TestStats, and the counters of the site.
+		 @param site @optional Site of the assertion, if known.
+		 @return AssertionResult::Passed.
+		 */
+		inline AssertionResult passedAt(internal::Site *site)
+		{
+			if (site)
+			{
+				site->totalPasses++;
+#ifdef LITEST_POSIX
+				internal::crashState().lastLine = site->line;
+#endif
+			}
+			return this->passed(site);
+		}
+		
+		/**
+		 Decide whether to evaluate a sampled assertion, and count the decision.
+		 @param site Site of the assertion.
+		 @param rate Evaluate about 1 in `rate` times.
+		 @param adaptive Use adaptive sampling; see internal::Site::sample().
+		 @return Whether to evaluate the assertion.
+		 */
+		inline bool sample(internal::Site &site, long long rate, bool adaptive)
+		{
+			if (site.enterTest()) this->sampledSites_.push_back(&site);
+			bool evaluate = site.sample(rate, adaptive);
+			if (evaluate)
+			{
+				this->totalStats_.sampled++;
+				this->stats_[counter].sampled++;
+			}
+			else
+			{
+				site.skips++;
+				site.reach();
+				this->totalStats_.skips++;
+				this->stats_[counter].skips++;
+			}
+			return evaluate;
+		}
+		
+		/**
+		 Count an evaluation of an assertion site.
+		 @param site @optional Site of the assertion, if known.
+		 */
+		inline void evaluating(internal::Site *site)
+		{
+			if (site) site->evaluate();
+		}
+		
+		/**
+		 Register a failed assertion at a site, and decide whether to report it.
+		 Updates current and total TestStats. Failures beyond failureReportLimit at the same site in the same test
+		 are counted but not reported; they are summed up before the test footer instead.
+		 @param site @optional Site of the assertion, if known.
+		 @return Whether the failure should be reported to the output formatter.
+		 */
+		inline bool failedAt(internal::Site *site)
+		{
+			this->failed(site);
+			if (!site) return true;
+			site->totalFails++;
+			site->adaptiveBase = site->evaluations + site->skips;
+			if (++site->fails <= this->failureReportLimit || this->failureReportLimit <= 0) return true;
+			if (site->fails == this->failureReportLimit + 1)
+			{
+				site->firstSuppressed = site->evaluations;
+				this->suppressedSites_.push_back(site);
+			}
+			return false;
+		}
+		
+		/**
+		 Get the assertion sites of this TestSuite and how often each was reached in the current or last run.
+		 These are the sites reached in the run, and the sites that were not but lie between the line of one of
+		 the tests of this TestSuite and the next test defined in the same file, whichever suite it belongs to.
+		 For tests added without a line, the sites in their whole file are included.
+		 Expansions of the same assertion in several instantiations of a template are merged.
+		 With LITEST_SITE_SECTION defined, sites are known before they are reached, so that the ones that never
+		 were (for example because an earlier assertion aborted the test) can be found.
+		 @return Sites ordered by file and line.
+		 */
+		inline std::vector<AssertionSite> assertionSites() const
+		{
+			// Lines covered by each test: from its definition to the next test definition in the file
+			struct Range { std::string file; int first, last; };
+			std::vector<Range> ranges;
+			std::map<std::string, std::vector<int>> testLines;
+			for (Test const& test : this->tests)
+			{
+				if (test.line <= 0)
+				{
+					ranges.push_back({test.file, 0, std::numeric_limits<int>::max()});
+					continue;
+				}
+				if (!testLines.count(test.file)) testLines[test.file] = internal::testLines(test.file);
+				std::vector<int> const& lines = testLines[test.file];
+				auto next = std::upper_bound(lines.begin(), lines.end(), test.line);
+				ranges.push_back({test.file, test.line, next == lines.end() ? std::numeric_limits<int>::max() : *next - 1});
+			}
+			
+			std::vector<AssertionSite> sites;
+			for (internal::Site *site : internal::allSites())
+			{
+				if (site->hits == 0 && std::none_of(ranges.begin(), ranges.end(), [&](Range const& range) {
+					return range.file == site->file && site->line >= range.first && site->line <= range.last;
+				})) continue;
+				if (!sites.empty() && sites.back().line == site->line && sites.back().file == site->file && sites.back().expr == site->expr)
+				{
+					sites.back().hits += site->hits;
+					sites.back().passes += site->totalPasses;
+					sites.back().fails += site->totalFails;
+					sites.back().nanoseconds += site->estimatedNanoseconds();
+				}
+				else
+					sites.push_back({site->file, site->line, site->expr, site->hits, site->totalPasses, site->totalFails, site->estimatedNanoseconds()});
+			}
+			
+			// Counters of tests replayed from a checkpoint journal
+			for (AssertionSite const& carried : this->carriedSites_)
+			{
+				auto same = std::find_if(sites.begin(), sites.end(), [&](AssertionSite const& site) {
+					return site.line == carried.line && site.file == carried.file && site.expr == carried.expr;
+				});
+				if (same == sites.end())
+				{
+					auto after = std::find_if(sites.begin(), sites.end(), [&](AssertionSite const& site) {
+						return site.file > carried.file || (site.file == carried.file && site.line > carried.line);
+					});
+					sites.insert(after, carried);
+					continue;
+				}
+				same->hits += carried.hits;
+				same->passes += carried.passes;
+				same->fails += carried.fails;
+				same->nanoseconds += carried.nanoseconds;
+			}
+			return sites;
+		}
+		
 		/**
 		 Get the stats of the current test.
 		 @return Current TestStats.
@@ -721,6 +6168,30 @@ namespace litest
 			return this->stats_[counter];
 		}
 		
+		/**
+		 Get the environment benchmarks run in.
+		 The machine is inspected before the first benchmark of a run, and the environment is reported to the output formatter.
+		 @return Benchmark environment.
+		 */
+		inline bench::Environment const& benchmarkEnvironment()
+		{
+			if (!this->benchmarkEnvironment_)
+			{
+				this->benchmarkEnvironment_.reset(new bench::Environment(bench::inspectEnvironment()));
+				this->output->formatBenchmarkEnvironment(*this->benchmarkEnvironment_);
+			}
+			return *this->benchmarkEnvironment_;
+		}
+		
+		/**
+		 Get the machine calibration of the current run.
+		 @return Calibration results, or `nullptr` if calibrate is not set.
+		 */
+		inline bench::Calibration const* calibration() const
+		{
+			return this->calibration_.get();
+		}
+		
 		/**
 		 Get the total stats of this TestSuite.
 		 @return Total TestStats.
@@ -739,6 +6210,63 @@ namespace litest
 		/** Descriptive name of this test suite. */
 		std::string suiteName;
 		
+		/**
+		 Whether to measure the machine at the start of each run, so that benchmark results
+		 can be compared across hosts. See bench::Calibration.
+		 */
+		bool calibrate = false;
+		
+		/**
+		 Whether to capture the standard output and standard error of each test. Captured output is attached
+		 to the Test and reported through TestResultFormatter::formatCapturedOutput(), instead of interleaving
+		 with the report. Writes to the report through `std::cout` or `std::cerr` go to the original streams.
+		 */
+		Capture captureOutput = Capture::Off;
+		
+		/**
+		 What to do when a test crashes. Unless Off, the test, its last passed assertion and a backtrace are
+		 written to standard error. With Resume, the binary is re-executed with the same arguments; earlier
+		 runs are skipped, and the run continues after the crashed test, which is reported as aborted.
+		 The report must be written to a standard stream or a ReportFile for it to be completed after a crash.
+		 */
+		CrashHandling crashHandling = CrashHandling::Off;
+		
+		/**
+		 Seed of runs, from which each test gets its own sequence of litest::rng(). If 0, a seed is chosen at random
+		 for each process. The `LITEST_SEED` environment variable overrides it, to replay a failure: the seed is
+		 reported for failed tests that used the generator.
+		 */
+		uint64_t seed = 0;
+		
+		/**
+		 Number of times each test is run to check that it is deterministic. With 2 or more, the sequence of
+		 assertions of each run (their sites, outcomes and values) is hashed and compared with that of the first
+		 run, which is the one reported. A test whose runs differ is reported with the first differing assertion,
+		 and fails. The `LITEST_DETERMINISM_RUNS` environment variable overrides it. Async tests are run once.
+		 */
+		int determinismRuns = 1;
+		
+		/**
+		 Path of a checkpoint journal, which each completed test is saved to with its stats and its part of the
+		 report. If empty, the `LITEST_CHECKPOINT` environment variable names the journal, if set. Async tests are
+		 not saved. See resumeFromCheckpoint.
+		 */
+		std::string checkpointFile;
+		
+		/**
+		 Whether to continue a run that was interrupted, from its checkpoint journal: tests saved in it are not
+		 run again, but their part of the report is written again and their stats are added to totalTestStats(),
+		 so the report is the same as that of an uninterrupted run. Also set by a non-empty
+		 `LITEST_CHECKPOINT_RESUME` environment variable. Otherwise, the journal is emptied by the first run of the process.
+		 */
+		bool resumeFromCheckpoint = false;
+		
+		/**
+		 Number of failures reported in full per assertion site and test; later failures at the site are only counted.
+		 Zero or less reports every failure.
+		 */
+		long long failureReportLimit = 10;
+		
 		/** Ordered list of the tests to run. */
 		std::vector<Test> tests;
 		
@@ -758,6 +6286,42 @@ namespace litest
 		
 		/** Total stats. */
 		TestStats totalStats_;
+		
+		/** Machine-readable result channel to litest-run. */
+		internal::ReportPipe reportPipe_;
+		
+		/** Benchmark environment, inspected on first use in a run. */
+		std::shared_ptr<bench::Environment> benchmarkEnvironment_;
+		
+		/** Machine calibration of the current run. */
+		std::shared_ptr<bench::Calibration> calibration_;
+		
+		/** Assertion sites of the current test with failures that were not reported. */
+		std::vector<internal::Site*> suppressedSites_;
+		
+		/** Sampled assertion sites reached in the current test. */
+		std::vector<internal::Site*> sampledSites_;
+		
+		/** The test that is running, if any. */
+		Test *currentTest_ = nullptr;
+		
+		/**
+		 Outcome of each test selected for the current run: "passed", "failed", "skipped", or empty if not run yet.
+		 Tests that ran before a crash the run was resumed after may instead be "run before the crash", if their outcome was not carried over.
+		 */
+		std::map<std::string, std::string> outcomes_;
+		
+		/** Dependencies that close a cycle in the current run, as (test, dependency) pairs of names; see orderByDependencies(). */
+		std::set<std::pair<std::string, std::string>> dependencyCycles_;
+		
+		/** Time point when the current run started. */
+		TimeType startTime_;
+		
+		/** Assertion site counters of the tests replayed from a checkpoint journal in the current run. */
+		std::vector<AssertionSite> carriedSites_;
+		
+		/** Trace of the assertions of the running test, while checking that it is deterministic. */
+		internal::AssertionTrace *trace_ = nullptr;
 	};
 
 	
@@ -776,6 +6340,7 @@ namespace litest
 	AssertionResult reportException(TestSuite &suite, int line, std::string exprstr, std::string msg, OnAssertionFailure onFail = OnAssertionFailure::Abort)
 	{
 		suite.failed();
+		suite.traceValue(msg);
 		suite.output->formatUnexpectedException(line, exprstr, msg);
 		if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("Unexpected exception in: " + exprstr);
 		if (onFail == OnAssertionFailure::Abort) throw TestAbortException(line, "Caught in assertion");
@@ -793,6 +6358,7 @@ namespace litest
 	 @param onFail @optional Action to take if the values are not equal.
 	 @param exprstr @optional A string representation of the tested code.
 	 @param line @optional The line number where this assertion was defined.
+	 @param site @optional Site of the assertion, for per-site failure counting.
 	 
 	 @throws AssertionFailureException
 	 @throws TestAbortException
@@ -800,22 +6366,23 @@ namespace litest
 	 @return Result of the assertion.
 	 */
 	template<typename T>
-	inline AssertionResult equal(TestSuite &suite, T val, std::function<T(void)> func, OnAssertionFailure onFail = OnAssertionFailure::Continue, std::string exprstr = "N/A", int line = 0)
+	inline AssertionResult equal(TestSuite &suite, T val, std::function<T(void)> func, OnAssertionFailure onFail = OnAssertionFailure::Continue, std::string exprstr = "N/A", int line = 0, internal::Site *site = nullptr)
 	{
+		suite.evaluating(site);
 		try
 		{
-			T res = func();
+			T res = internal::timed(site, func);
 			if (!(res == val))
 			{
-				suite.failed();
-				suite.output->formatFailedEquals(line, exprstr, val, res);
+				if (suite.failedAt(site)) suite.output->formatFailedEquals(line, exprstr, val, res);
+				if (suite.tracing()) suite.traceValue(internal::descriptionIfAvailable(res));
 				if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("Unexpected value in: " + exprstr);
 				if (onFail == OnAssertionFailure::Abort) throw TestAbortException(line, "Equal failed.");
 				return AssertionResult::Failed;
 			}
 			else
 			{
-				suite.passed();
+				suite.passedAt(site);
 				suite.output->formatPassedEquals(line, exprstr, internal::descriptionIfAvailable(val));
 				return AssertionResult::Passed;
 			}
@@ -825,40 +6392,153 @@ namespace litest
 	}
 	
 	/**
-	 Asserts that the return value of a lambda expression is equal to `true`.
+	 Asserts that the return value of a lambda expression is equal to `true`.
+	 
+	 @param suite TestSuite used as context.
+	 @param func Function object wrapping the code, returning a `bool`.
+	 @param onFail @optional Action to take if the return value is `false`.
+	 @param exprstr @optional A string representation of the tested code.
+	 @param line @optional The line number where this assertion was defined.
+	 
+	 @throws AssertionFailureException
+	 @throws TestAbortException
+	 
+	 @return Result of the assertion.
+	 */
+	inline AssertionResult check(TestSuite &suite, std::function<bool(void)> func, OnAssertionFailure onFail = OnAssertionFailure::Continue, std::string exprstr = "N/A", int line = 0)
+	{
+		bool res;
+		try { res = func(); }
+		catch (std::exception &e) { return reportException(suite, line, exprstr, e.what()); }
+		catch (...) { return reportException(suite, line, exprstr, "N/A"); }
+		
+		if (!res)
+		{
+			suite.failed();
+			suite.output->formatFailedCheck(line, exprstr);
+			if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("Broken assertion in: " + exprstr);
+			if (onFail == OnAssertionFailure::Abort) throw TestAbortException(line, "Check failed.");
+			return AssertionResult::Failed;
+		}
+		else
+		{
+			suite.passed();
+			suite.output->formatPassedCheck(line, exprstr);
+			return AssertionResult::Passed;
+		}
+	}
+	
+	/**
+	 Asserts that a decomposed expression is true. Used by LT_CHECK and LT_REQUIRE.
+	 
+	 The expression is captured by internal::Decomposer, so that the values of its operands can be reported
+	 on failure. The operands are only described if the assertion fails.
+	 
+	 @tparam Func Type of the function object.
+	 
+	 @param suite TestSuite used as context.
+	 @param func Function object wrapping the code, returning an internal::Evaluation.
+	 @param onFail Action to take if the expression is `false`.
+	 @param exprstr A string representation of the tested code.
+	 @param line The line number where this assertion was defined.
+	 @param site @optional Site of the assertion, for per-site failure counting.
+	 
+	 @throws AssertionFailureException
+	 @throws TestAbortException
+	 
+	 @return Result of the assertion.
+	 */
+	template<typename Func>
+	inline AssertionResult checkExpression(TestSuite &suite, Func const& func, OnAssertionFailure onFail, const char *exprstr, int line, internal::Site *site = nullptr)
+	{
+		suite.evaluating(site);
+		try
+		{
+			internal::Evaluation eval = internal::timed(site, func);
+			if (eval.passed)
+			{
+				suite.passedAt(site);
+				suite.output->formatPassedCheck(line, exprstr);
+				return AssertionResult::Passed;
+			}
+			
+			bool report = suite.failedAt(site);
+			if (report || suite.tracing())
+			{
+				std::string values = internal::describeOperands(exprstr, eval);
+				suite.traceValue(values);
+				if (report && values.empty()) suite.output->formatFailedCheck(line, exprstr);
+				else if (report) suite.output->formatFailedCheckValues(line, exprstr, values);
+			}
+		}
+		catch (std::exception &e) { return reportException(suite, line, exprstr, e.what()); }
+		catch (...) { return reportException(suite, line, exprstr, "N/A"); }
+		
+		if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("Broken assertion in: " + std::string(exprstr));
+		if (onFail == OnAssertionFailure::Abort) throw TestAbortException(line, "Check failed.");
+		return AssertionResult::Failed;
+	}
+	
+	/**
+	 Asserts that a decomposed expression becomes true within a timeout. Used by LT_EVENTUALLY and LT_EVENTUALLY_REQ.
+	 
+	 The expression is polled, waiting 1 µs after the first evaluation and twice as long after each further one
+	 (at most 10 ms), or until litest::wakeWaiters() is called. With VirtualClock::fastForward() on, the timeout
+	 runs on virtual time and the waits advance the clock instead, without the 10 ms limit. The last evaluation is
+	 checked like in checkExpression(); the time spent waiting is not counted in the time of the assertion site.
+	 
+	 @tparam Func Type of the function object.
 	 
 	 @param suite TestSuite used as context.
-	 @param func Function object wrapping the code, returning a `bool`.
-	 @param onFail @optional Action to take if the return value is `false`.
-	 @param exprstr @optional A string representation of the tested code.
-	 @param line @optional The line number where this assertion was defined.
+	 @param func Function object wrapping the code, returning an internal::Evaluation.
+	 @param timeout Maximum time to wait.
+	 @param onFail Action to take if the expression is still `false` after the timeout.
+	 @param exprstr A string representation of the tested code.
+	 @param line The line number where this assertion was defined.
+	 @param site @optional Site of the assertion, for per-site failure counting.
 	 
 	 @throws AssertionFailureException
 	 @throws TestAbortException
 	 
 	 @return Result of the assertion.
 	 */
-	inline AssertionResult check(TestSuite &suite, std::function<bool(void)> func, OnAssertionFailure onFail = OnAssertionFailure::Continue, std::string exprstr = "N/A", int line = 0)
+	template<typename Func>
+	inline AssertionResult eventually(TestSuite &suite, Func const& func, std::chrono::nanoseconds timeout, OnAssertionFailure onFail, const char *exprstr, int line, internal::Site *site = nullptr)
 	{
-		bool res;
-		try { res = func(); }
-		catch (std::exception &e) { return reportException(suite, line, exprstr, e.what()); }
-		catch (...) { return reportException(suite, line, exprstr, "N/A"); }
-		
-		if (!res)
-		{
-			suite.failed();
-			suite.output->formatFailedCheck(line, exprstr);
-			if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("Broken assertion in: " + exprstr);
-			if (onFail == OnAssertionFailure::Abort) throw TestAbortException(line, "Check failed.");
-			return AssertionResult::Failed;
-		}
-		else
-		{
-			suite.passed();
-			suite.output->formatPassedCheck(line, exprstr);
-			return AssertionResult::Passed;
-		}
+		return checkExpression(suite, [&]() -> internal::Evaluation {
+			bool virtualTime = VirtualClock::fastForward();
+			auto start = std::chrono::steady_clock::now();
+			auto virtualStart = VirtualClock::now();
+			std::chrono::nanoseconds backoff = std::chrono::microseconds(1);
+			internal::Waiters &waiters = internal::waiters();
+			while (true)
+			{
+				unsigned long generation;
+				{
+					std::lock_guard<std::mutex> lock(waiters.mutex);
+					generation = waiters.generation;
+				}
+				internal::Evaluation eval = func();
+				std::chrono::nanoseconds elapsed = virtualTime ? VirtualClock::now() - virtualStart : std::chrono::steady_clock::now() - start;
+				if (eval.passed || elapsed >= timeout) return eval;
+				
+				std::chrono::nanoseconds wait = std::min(backoff, timeout - elapsed);
+				if (virtualTime)
+				{
+					VirtualClock::advance(wait);
+					if (backoff < timeout) backoff *= 2;
+					continue;
+				}
+				
+				auto waitStart = std::chrono::steady_clock::now();
+				{
+					std::unique_lock<std::mutex> lock(waiters.mutex);
+					waiters.woken.wait_for(lock, wait, [&] { return waiters.generation != generation; });
+				}
+				internal::SiteTimer::exclude(std::chrono::steady_clock::now() - waitStart);
+				backoff = std::min<std::chrono::nanoseconds>(backoff * 2, std::chrono::milliseconds(10));
+			}
+		}, onFail, exprstr, line, site);
 	}
 	
 	/**
@@ -871,6 +6551,7 @@ namespace litest
 	 @param onFail @optional Action to take if `func` did not throw, or threw of another type.
 	 @param exprstr @optional A string representation of the tested code.
 	 @param line @optional The line number where this assertion was defined.
+	 @param site @optional Site of the assertion, for per-site failure counting.
 	 
 	 @throws AssertionFailureException
 	 @throws TestAbortException
@@ -878,20 +6559,20 @@ namespace litest
 	 @return Result of the assertion.
 	 */
 	template<typename ThrownType>
-	inline AssertionResult throwsType(TestSuite &suite, std::function<void(void)> func, OnAssertionFailure onFail = OnAssertionFailure::Continue, std::string exprstr = "N/A", int line = 0)
+	inline AssertionResult throwsType(TestSuite &suite, std::function<void(void)> func, OnAssertionFailure onFail = OnAssertionFailure::Continue, std::string exprstr = "N/A", int line = 0, internal::Site *site = nullptr)
 	{
-		try { func(); }
+		suite.evaluating(site);
+		try { internal::timed(site, func); }
 		catch (ThrownType &e)
 		{
-			suite.passed();
+			suite.passedAt(site);
 			suite.output->formatPassedThrow(line, exprstr);
 			return AssertionResult::Passed;
 		}
 		catch (std::exception &e) { return reportException(suite, line, exprstr, e.what()); }
 		catch (...) { return reportException(suite, line, exprstr, "Uncaught exception in exception assertion"); }
 		
-		suite.failed();
-		suite.output->formatFailedThrow(line, exprstr);
+		if (suite.failedAt(site)) suite.output->formatFailedThrow(line, exprstr);
 		if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("No exception in " + exprstr);
 		if (onFail == OnAssertionFailure::Abort) throw TestAbortException(line, "No exception in throw assertion.");
 		return AssertionResult::Failed;
@@ -905,28 +6586,77 @@ namespace litest
 	 @param onFail @optional Action to take if `func` did not throw.
 	 @param exprstr @optional A string representation of the tested code.
 	 @param line @optional The line number where this assertion was defined.
+	 @param site @optional Site of the assertion, for per-site failure counting.
 	 
 	 @throws AssertionFailureException
 	 @throws TestAbortException
 	 
 	 @return Result of the assertion.
 	 */
-	inline AssertionResult throws(TestSuite &suite, std::function<void(void)> func, OnAssertionFailure onFail = OnAssertionFailure::Continue, std::string exprstr = "N/A", int line = 0)
+	inline AssertionResult throws(TestSuite &suite, std::function<void(void)> func, OnAssertionFailure onFail = OnAssertionFailure::Continue, std::string exprstr = "N/A", int line = 0, internal::Site *site = nullptr)
 	{
-		try { func(); }
+		suite.evaluating(site);
+		try { internal::timed(site, func); }
 		catch (...)
 		{
-			suite.passed();
+			suite.passedAt(site);
 			suite.output->formatPassedThrow(line, exprstr);
 			return AssertionResult::Passed;
 		}
-		suite.failed();
-		suite.output->formatFailedThrow(line, exprstr);
+		if (suite.failedAt(site)) suite.output->formatFailedThrow(line, exprstr);
 		if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("No exception in: " + exprstr);
 		if (onFail == OnAssertionFailure::Abort) throw TestAbortException(line, "No exception in throw assertion.");
 		return AssertionResult::Failed;
 	}
 	
+	/**
+	 Asserts that a block of code makes no system calls. Used by LT_NO_SYSCALLS.
+	 
+	 Seccomp filters cannot be removed once installed, so the block runs in a forked child process, where every
+	 system call is trapped, counted by number and made to fail with `ENOSYS`. The child ends after the block.
+	 Code that does not handle the failure of a call, such as an allocation that needs memory from the kernel,
+	 may crash or throw; this is reported after the calls. Without LITEST_SECCOMP, the block is not run and a
+	 message says so.
+	 
+	 @tparam Func Type of the function object.
+	 
+	 @param suite TestSuite used as context.
+	 @param func Function object wrapping the block.
+	 @param line The line number where this assertion was defined.
+	 @param site @optional Site of the assertion, for per-site failure counting.
+	 @param timeout @optional Time after which the block is stopped, e.g. if it keeps retrying a failed call.
+	 
+	 @throws AssertionFailureException
+	 
+	 @return Result of the assertion.
+	 */
+	template<typename Func>
+	inline AssertionResult noSyscalls(TestSuite &suite, Func const& func, int line, internal::Site *site = nullptr, std::chrono::milliseconds timeout = std::chrono::seconds(10))
+	{
+#ifdef LITEST_SECCOMP
+		const char *exprstr = "no system calls";
+		suite.evaluating(site);
+		std::string calls = internal::runWithoutSyscalls(func, timeout);
+		if (calls.empty())
+		{
+			suite.passedAt(site);
+			suite.output->formatPassedCheck(line, exprstr);
+			return AssertionResult::Passed;
+		}
+		bool report = suite.failedAt(site);
+		suite.traceValue(calls);
+		if (report) suite.output->formatFailedCheckValues(line, exprstr, calls);
+		if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("Broken assertion in: " + std::string(exprstr));
+		return AssertionResult::Failed;
+#else
+		(void)func;
+		(void)site;
+		(void)timeout;
+		suite.output->formatMessage(line, "Not run: system calls can only be trapped on Linux on x86-64 and AArch64");
+		return AssertionResult::Skipped;
+#endif
+	}
+	
 	/**
 	 Manually generates a failure.
 	 
@@ -934,21 +6664,121 @@ namespace litest
 	 @param reason Reason for the failure.
 	 @param onFail @optional Action to take.
 	 @param line @optional The line number where this assertion was defined.
+	 @param site @optional Site of the assertion, for per-site failure counting.
 	 
 	 @throws AssertionFailureException
 	 @throws TestAbortException
 	 
 	 @return Result of the assertion.
 	 */
-	inline AssertionResult generateFailure(TestSuite &suite, std::string reason, OnAssertionFailure onFail = OnAssertionFailure::Continue, int line = 0)
+	inline AssertionResult generateFailure(TestSuite &suite, std::string reason, OnAssertionFailure onFail = OnAssertionFailure::Continue, int line = 0, internal::Site *site = nullptr)
 	{
-		suite.failed();
-		suite.output->formatManualFailure(line, reason);
+		suite.evaluating(site);
+		if (suite.failedAt(site)) suite.output->formatManualFailure(line, reason);
 		if (suite.mode == TestSuite::Mode::Throw) throw AssertionFailureException("Manual failure, reason: " + reason);
 		if (onFail == OnAssertionFailure::Abort) throw TestAbortException(line, "Manual failure");
 		return AssertionResult::Failed;
 	}
 	
+	/**
+	 Measures the running time of some code.
+	 
+	 The code is run once to warm up, then in batches whose iteration count doubles until a batch takes
+	 at least `sampleTime`, and then for `samples` timed batches. If this process was given CPUs by litest-run,
+	 the measurement runs pinned to the first of them.
+	 
+	 @param suite TestSuite used as context.
+	 @param name Name of the benchmark.
+	 @param func Function object wrapping the code to measure.
+	 @param line @optional The line number where this benchmark was defined.
+	 @param samples @optional Number of timed samples.
+	 @param sampleTime @optional Minimum duration of a sample, in seconds.
+	 
+	 @throws AssertionFailureException
+	 @throws TestAbortException
+	 
+	 @return The benchmark result.
+	 */
+	inline bench::Result benchmark(TestSuite &suite, std::string name, std::function<void(void)> func, int line = 0, int samples = 10, double sampleTime = 0.005)
+	{
+		bench::Result result;
+		result.name = name;
+		result.reliable = suite.benchmarkEnvironment().reliable();
+		
+		std::vector<int> assigned = placement::assignedCpus();
+		placement::ScopedPin pin(assigned.empty() ? assigned : std::vector<int>{ assigned[0] });
+		
+		auto runBatch = [&] (long long iterations)
+		{
+			auto start = TimeTypeHiRes::clock::now();
+			for (long long i = 0; i < iterations; ++i) func();
+			return std::chrono::duration<double>(TimeTypeHiRes::clock::now() - start).count();
+		};
+		
+		try
+		{
+			runBatch(1);
+			long long iterations = 1;
+			while (runBatch(iterations) < sampleTime && iterations < (1LL << 40)) iterations *= 2;
+			
+			std::vector<double> ns;
+			for (int i = 0; i < samples; ++i) ns.push_back(runBatch(iterations) * 1e9 / iterations);
+			std::sort(ns.begin(), ns.end());
+			
+			result.iterations = iterations;
+			result.samples = samples;
+			result.minNs = ns.front();
+			result.medianNs = ns[ns.size() / 2];
+			result.meanNs = std::accumulate(ns.begin(), ns.end(), 0.0) / ns.size();
+			if (suite.calibration()) result.referenceOps = result.medianNs * suite.calibration()->intOpsPerNs;
+		}
+		catch (TestAbortException&) { throw; }
+		catch (AssertionFailureException&) { throw; }
+		catch (std::exception &e) { reportException(suite, line, name, e.what()); return bench::Result(); }
+		catch (...) { reportException(suite, line, name, "N/A"); return bench::Result(); }
+		
+		suite.output->formatBenchmark(line, result);
+		return result;
+	}
+	
+	namespace bench
+	{
+		/**
+		 Runs a benchmark for each combination of working-set size and stride.
+		 
+		 For each size, a Buffer is allocated with the given policies and the benchmark is run once per stride,
+		 named after the size and stride. The benchmarked function is called with the buffer, the size and the stride.
+		 
+		 @param suite TestSuite used as context.
+		 @param name Name of the benchmark series.
+		 @param sizes Working-set sizes in bytes, e.g. from sweepSizes().
+		 @param strides Strides in bytes.
+		 @param func Function object to measure.
+		 @param line @optional The line number where this benchmark was defined.
+		 @param options @optional Allocation policies of the buffers.
+		 
+		 @throws AssertionFailureException
+		 @throws TestAbortException
+		 
+		 @return The results, in order of size and then stride.
+		 */
+		inline std::vector<Result> sweep(TestSuite &suite, std::string name, std::vector<size_t> sizes, std::vector<size_t> strides,
+			std::function<void(Buffer &, size_t, size_t)> func, int line = 0, BufferOptions options = BufferOptions())
+		{
+			std::vector<Result> results;
+			for (size_t size : sizes)
+			{
+				Buffer buffer(size, options);
+				for (size_t stride : strides)
+				{
+					std::string label = name + " (size " + formatBytes((double)size) + ", stride " + formatBytes((double)stride) + ")";
+					results.push_back(benchmark(suite, label, [&] { func(buffer, size, stride); }, line));
+				}
+			}
+			return results;
+		}
+	}
+	
 #pragma mark - Result Formatter
 	
 	/** Destructor. Does nothing. */
@@ -984,7 +6814,7 @@ namespace litest
 		 Constructor.
 		 @param ostr Output stream to write the Markdown formatted output to.
 		 */
-		TestResultFormatterMarkdown<level>(std::ostream &ostr)
+		TestResultFormatterMarkdown(std::ostream &ostr)
 		: TestResultFormatter(ostr) {}
 		
 		/**
@@ -999,14 +6829,66 @@ namespace litest
 		
 		inline void formatTestFooter(Test const& test, TestStats stats) override
 		{
-			s << std::endl << "**Total passed / failed assertions: " << stats.passes << " / " << stats.fails << "**" << std::endl;
+			s << std::endl << "**Total passed / failed assertions: " << stats.passes << " / " << stats.fails << "**" << coverage(stats) << std::endl;
 		}
 		
 		inline void formatTestSuiteEnd(TestSuite const& suite) override
 		{
 			s << std::endl << " Summary" << std::endl;
 			s << "------------------------------------------------" << std::endl;
-			s << "**Total passed / failed assertions: " << suite.totalTestStats().passes << " / " << suite.totalTestStats().fails <<  "**"  << std::endl << std::endl;
+			if (suite.totalTestStats().skippedTests > 0)
+				s << "- Skipped tests: " << suite.totalTestStats().skippedTests << std::endl;
+			if (suite.totalTestStats().nondeterministic > 0)
+				s << "- Nondeterministic tests: " << suite.totalTestStats().nondeterministic << std::endl;
+			s << "**Total passed / failed assertions: " << suite.totalTestStats().passes << " / " << suite.totalTestStats().fails <<  "**" << coverage(suite.totalTestStats()) << std::endl << std::endl;
+		}
+		
+		/**
+		 Lists the assertion sites that were never reached, and all sites with their hit counts when logging everything.
+		 Then tabulates the sites that took the most evaluation time.
+		 @param sites Assertion sites of the suite.
+		 */
+		inline void formatAssertionSites(std::vector<AssertionSite> const& sites) override
+		{
+			if (sites.empty()) return;
+			size_t reached = std::count_if(sites.begin(), sites.end(), [](AssertionSite const& site) { return site.hits > 0; });
+			s << std::endl << " Assertion sites" << std::endl;
+			s << "------------------------------------------------" << std::endl;
+			for (AssertionSite const& site : sites)
+			{
+				if (site.hits == 0) s << "- " << site.file << ":" << site.line << ":\t**Never reached:** `" << site.expr << "`" << std::endl;
+				else if (logPasses) s << "- " << site.file << ":" << site.line << ":\tReached " << site.hits << " times: `" << site.expr << "`" << std::endl;
+			}
+			s << std::endl << "**Reached assertion sites: " << reached << " / " << sites.size() << "**" << std::endl;
+			
+			if (!logMesages) return;
+			std::vector<AssertionSite> hot(sites);
+			std::sort(hot.begin(), hot.end(), [](AssertionSite const& a, AssertionSite const& b) { return a.nanoseconds > b.nanoseconds; });
+			if (hot.size() > hotSites) hot.resize(hotSites);
+			s << std::endl << "| Site | Expression | Passes | Fails | Time (µs) |" << std::endl;
+			s << "|------|------------|-------:|------:|----------:|" << std::endl;
+			for (AssertionSite const& site : hot)
+			{
+				if (site.passes + site.fails == 0) break;
+				s << "| " << site.file << ":" << site.line << " | `" << site.expr << "` | " << site.passes << " | " << site.fails << " | "
+					<< std::fixed << std::setprecision(1) << site.nanoseconds / 1e3 << std::defaultfloat << std::setprecision(6) << " |" << std::endl;
+			}
+		}
+		
+		/** Number of assertion sites listed in the table of evaluation times. */
+		static constexpr size_t hotSites = 5;
+		
+		/**
+		 Describe how much of the assertions were checked exhaustively and by sampling.
+		 @param stats Statistics.
+		 @return Description, or an empty string if no assertion was sampled.
+		 */
+		inline std::string coverage(TestStats const& stats)
+		{
+			if (stats.sampled + stats.skips == 0) return "";
+			std::stringstream ss;
+			ss << " (" << stats.passes + stats.fails - stats.sampled << " exhaustive, " << stats.sampled << " sampled, " << stats.skips << " skipped)";
+			return ss.str();
 		}
 		
 		inline void formatAbortedTest(int line, std::string reason) override
@@ -1014,6 +6896,29 @@ namespace litest
 			s << "- " << lineNr(line) << ":\t**Test aborted: " << reason << "**"  << std::endl;
 		}
 		
+		inline void formatSkippedTest(Test const& test, std::string reason) override
+		{
+			this->formatTestHeader(test);
+			s << "- **Skipped: " << reason << "**" << std::endl;
+		}
+		
+		inline void formatNondeterminism(std::string difference) override
+		{
+			s << "- **Nondeterministic: " << difference << "**" << std::endl;
+		}
+		
+		inline void formatRandomSeed(uint64_t seed) override
+		{
+			s << "- Random seed: `0x" << std::hex << seed << std::dec << "`; replay with `" LITEST_SEED_ENV "=0x" << std::hex << seed << std::dec << "`" << std::endl;
+		}
+		
+		inline void formatCapturedOutput(Test const& test, CapturedOutput const& output) override
+		{
+			s << std::endl << "Output:" << std::endl << "~~~" << std::endl;
+			output.writeTo(s);
+			s << std::endl << "~~~" << std::endl;
+		}
+		
 		inline void formatPassedCheck(int line, std::string expr) override
 		{
 			if (logPasses) s << "- " << lineNr(line) << ":\tPassed check: " << " in `" << expr << "`" << std::endl;
@@ -1049,6 +6954,11 @@ namespace litest
 			s << "- " << lineNr(line) << ":\tAssertion failed: `" << expr << "`" << std::endl;
 		}
 		
+		inline void formatFailedCheckValues(int line, std::string expr, std::string values) override
+		{
+			s << "- " << lineNr(line) << ":\tAssertion failed: `" << expr << "` with `" << values << "`" << std::endl;
+		}
+		
 		inline void formatFailedThrow(int line, std::string expr) override
 		{
 			s << "- " << lineNr(line) << ":\tExpected exception: `" << expr << "`" << std::endl;
@@ -1063,6 +6973,43 @@ namespace litest
 		{
 			s << "- " << lineNr(line) << ":\tManual failure, reason: '" << reason << "'" << std::endl;
 		}
+		
+		inline void formatSampledAssertion(int line, std::string expr, long long evaluations, long long skips) override
+		{
+			if (logMesages) s << "- " << lineNr(line) << ":\tSampled `" << expr << "`: evaluated " << evaluations << " of " << evaluations + skips
+				<< " times (" << std::setprecision(3) << 100.0 * evaluations / std::max(1LL, evaluations + skips) << std::setprecision(6) << "%)" << std::endl;
+		}
+		
+		inline void formatSuppressedFailures(int line, std::string expr, long long count, long long firstIteration) override
+		{
+			s << "- " << lineNr(line) << ":\t… `" << expr << "` failed " << count << " more times (first at iteration " << firstIteration << ")" << std::endl;
+		}
+		
+		inline void formatBenchmarkEnvironment(bench::Environment const& env) override
+		{
+			if (!logMesages) return;
+			s << "- Benchmark environment: " << env.description() << "." << std::endl;
+			for (std::string const& warning : env.warnings) s << "- **Benchmarks are unreliable: " << warning << ".**" << std::endl;
+		}
+		
+		inline void formatBenchmark(int line, bench::Result const& result) override
+		{
+			if (!logMesages) return;
+			s << "- " << lineNr(line) << ":\tBenchmark *" << result.name << "*: " << result.medianNs << " ns per iteration (median of "
+				<< result.samples << " samples of " << result.iterations << " iterations, min " << result.minNs << " ns)";
+			if (result.referenceOps > 0) s << ", " << result.referenceOps << " reference ops";
+			s << (result.reliable ? "" : " **unreliable**") << std::endl;
+		}
+		
+		inline void formatCalibration(bench::Calibration const& cal) override
+		{
+			s << std::endl << " Machine calibration" << std::endl;
+			s << "------------------------------------------------" << std::endl;
+			s << "- CPU: " << cal.cpuModel << ", L1d " << (cal.l1Size >> 10) << " KiB, L2 " << (cal.l2Size >> 10) << " KiB, LLC " << (cal.llcSize >> 10) << " KiB" << std::endl;
+			s << "- Memory bandwidth (triad): " << cal.bandwidthGBs << " GB/s" << std::endl;
+			s << "- Latency: L1 " << cal.l1LatencyNs << " ns, L2 " << cal.l2LatencyNs << " ns, LLC " << cal.llcLatencyNs << " ns" << std::endl;
+			s << "- Throughput: " << cal.intOpsPerNs << " integer ops/ns, " << cal.fpOpsPerNs << " floating-point ops/ns" << std::endl;
+		}
 			
 		inline std::string lineNr(int line)
 		{
@@ -1074,16 +7021,25 @@ namespace litest
 	
 #pragma mark - HTML Formatter
 	
-	/** Class for formatting of test result output in a HTML format, styled with inline CSS. */
-	class TestResultFormatterHTML : public TestResultFormatter
+	/** Class for formatting of test result output in a HTML format, styled with inline CSS, at a chosen log level.
+	 @tparam level Log level.
+	 */
+	template<LogLevel level>
+	class BasicTestResultFormatterHTML : public TestResultFormatter
 	{
 		public:
 		
+		/** Whether messages should be logged; shorthand for comparing the log level. */
+		static constexpr bool logMesages = level >= LogLevel::Messages;
+		
+		/** Whether passes should be logged; shorthand for comparing the log level. */
+		static constexpr bool logPasses = level >= LogLevel::Everything;
+		
 		/**
 		 Constructor.
 		 @param ostr Output stream to write the HTML formatted output to.
 		 */
-		TestResultFormatterHTML(std::ostream &ostr)
+		BasicTestResultFormatterHTML(std::ostream &ostr)
 		: TestResultFormatter(ostr) {}
 		
 		inline void formatTestHeader(Test const& test)
@@ -1106,38 +7062,74 @@ namespace litest
 			s << "</div><div class='result-badge'>" << annotation << "</div></div>";
 		}
 		
+		/** Copies the output rather than splicing it, as it has to be escaped. */
+		inline void formatCapturedOutput(Test const& test, CapturedOutput const& output) override
+		{
+			s << "<pre class='captured-output'>";
+			for (char c : output.str())
+			{
+				if (c == '<') s << "&lt;";
+				else if (c == '>') s << "&gt;";
+				else if (c == '&') s << "&amp;";
+				else s << c;
+			}
+			s << "</pre>";
+		}
+		
 		inline void formatAbortedTest(int line, std::string reason) override
 		{
 			s << "<div class='log-item abort'><span class='line-nr'>" << lineNr(line) << "</span>";
 			s << "↳ Test aborted: <span class='abort-msg'>" << reason << "</span></div>";
 		}
 		
+		inline void formatSkippedTest(Test const& test, std::string reason) override
+		{
+			s << "<div class='test skipped' id='test" << test.index << "'>";
+			s << "<h2 id='test-" << test.index << "-header'> Test " << test.index << ": <span class='test-title'>" << test.name << "</span></h2>";
+			s << "<p>Skipped: " << reason << "</p></div>";
+		}
+		
+		inline void formatNondeterminism(std::string difference) override
+		{
+			s << "<div class='log-item fail'>Nondeterministic: " << difference << "</div>";
+		}
+		
+		inline void formatRandomSeed(uint64_t seed) override
+		{
+			s << "<div class='log-item seed'>Random seed: <code>0x" << std::hex << seed << std::dec << "</code>; replay with <code>" LITEST_SEED_ENV "=0x" << std::hex << seed << std::dec << "</code></div>";
+		}
+		
 		inline void formatMessage(int line, std::string message) override
 		{
+			if (!logMesages) return;
 			s << "<div class='log-item message'><span class='line-nr'>" << lineNr(line) << "</span>";
 			s << "<span class='msg-txt'>" << message << "</em></div>";
 		}
 		
 		inline void formatExpr(int line, std::string exprstr, std::string valstr)
 		{
+			if (!logMesages) return;
 			s << "<div class='log-item message'><span class='line-nr'>" << lineNr(line) << "</span>";
 			s << "Print expression <code>" << exprstr << "</code>: <code>" << valstr << "</code></div>";
 		}
 		
 		inline void formatPassedCheck(int line, std::string expr) override
 		{
+			if (!logPasses) return;
 			s << "<div class='log-item pass check'><span class='line-nr'>" << lineNr(line) << "</span>";
 			s << "Passed check: <code>" << expr << "</code></div>";
 		}
 		
 		inline void formatPassedThrow(int line, std::string expr) override
 		{
+			if (!logPasses) return;
 			s << "<div class='log-item pass throw'><span class='line-nr'>" << lineNr(line) << "</span>";
 			s << "Passed throw check: <code>" << expr << "</code></div>";
 		}
 		
 		inline void formatPassedEquals(int line, std::string expr, std::string val) override
 		{
+			if (!logPasses) return;
 			s << "<div class='log-item pass equals'><span class='line-nr'>" << lineNr(line) << "</span>";
 			s << "Passed equals: <code>" << expr << "</code> == <code>" << val << "</code></div>";
 		}
@@ -1154,6 +7146,12 @@ namespace litest
 			s << "Failed check: <code>" << expr << "</code></div>";
 		}
 		
+		inline void formatFailedCheckValues(int line, std::string expr, std::string values) override
+		{
+			s << "<div class='log-item fail broken-assertion'><span class='line-nr'>" << lineNr(line) << "</span>";
+			s << "Failed check: <code>" << expr << "</code> with <code>" << values << "</code></div>";
+		}
+		
 		inline void formatFailedThrow(int line, std::string expr) override
 		{
 			s << "<div class='log-item fail no-exception'><span class='line-nr'>" << lineNr(line) << "</span>";
@@ -1172,6 +7170,53 @@ namespace litest
 			s << "Manual failure: <em>" << reason << "</em></div>";
 		}
 		
+		inline void formatSampledAssertion(int line, std::string expr, long long evaluations, long long skips) override
+		{
+			if (!logMesages) return;
+			s << "<div class='log-item message sampled'><span class='line-nr'>" << lineNr(line) << "</span>";
+			s << "Sampled <code>" << expr << "</code>: evaluated " << evaluations << " of " << evaluations + skips << " times</div>";
+		}
+		
+		inline void formatSuppressedFailures(int line, std::string expr, long long count, long long firstIteration) override
+		{
+			s << "<div class='log-item fail suppressed'><span class='line-nr'>" << lineNr(line) << "</span>";
+			s << "… <code>" << expr << "</code> failed " << count << " more times (first at iteration " << firstIteration << ")</div>";
+		}
+		
+		inline void formatBenchmarkEnvironment(bench::Environment const& env) override
+		{
+			if (!logMesages) return;
+			s << "<div class='log-item message'><span class='line-nr'>" << lineNr(0) << "</span>";
+			s << "Benchmark environment: <em>" << env.description() << "</em></div>";
+			for (std::string const& warning : env.warnings)
+			{
+				s << "<div class='log-item message'><span class='line-nr'>" << lineNr(0) << "</span>";
+				s << "Benchmarks are unreliable: <em>" << warning << "</em></div>";
+			}
+		}
+		
+		inline void formatBenchmark(int line, bench::Result const& result) override
+		{
+			if (!logMesages) return;
+			s << "<div class='log-item message benchmark'><span class='line-nr'>" << lineNr(line) << "</span>";
+			s << "Benchmark <code>" << result.name << "</code>: " << result.medianNs << " ns per iteration (median of " << result.samples;
+			s << " samples of " << result.iterations << " iterations, min " << result.minNs << " ns)";
+			if (result.referenceOps > 0) s << ", " << result.referenceOps << " reference ops";
+			if (!result.reliable) s << " <em>unreliable</em>";
+			s << "</div>";
+		}
+		
+		inline void formatCalibration(bench::Calibration const& cal) override
+		{
+			s << "<h2>Machine calibration</h2><table class='calibration'>";
+			s << "<tr><td>CPU</td><td>" << cal.cpuModel << "</td></tr>";
+			s << "<tr><td>Caches</td><td>L1d " << (cal.l1Size >> 10) << " KiB, L2 " << (cal.l2Size >> 10) << " KiB, LLC " << (cal.llcSize >> 10) << " KiB</td></tr>";
+			s << "<tr><td>Memory bandwidth (triad)</td><td>" << cal.bandwidthGBs << " GB/s</td></tr>";
+			s << "<tr><td>Latency</td><td>L1 " << cal.l1LatencyNs << " ns, L2 " << cal.l2LatencyNs << " ns, LLC " << cal.llcLatencyNs << " ns</td></tr>";
+			s << "<tr><td>Throughput</td><td>" << cal.intOpsPerNs << " integer ops/ns, " << cal.fpOpsPerNs << " floating-point ops/ns</td></tr>";
+			s << "</table>";
+		}
+		
 		inline void formatTestSuiteStart(TestSuite const& suite) override
 		{
 			std::time_t genTime = std::time(nullptr);
@@ -1216,6 +7261,8 @@ namespace litest
 				h2.passed { background-color: darkgreen; }\
 				h2.failed { background-color: darkred; }\
 				h2 { background-color: black; }\
+				table.sites tr.unreached td { color: darkred; font-weight: bold; }\
+				pre.captured-output { margin: 1em; padding: 0.5em; background-color: white; border-left: 3pt solid #999; }\
 			</style></head><body><div id='content'>\
 			<h1>" << suite.suiteName << "</h1>\
 			<p>Generated by LiTest at <time>" << std::put_time(std::localtime(&genTime), "%F %T") << "</time>.</p>\
@@ -1227,17 +7274,202 @@ namespace litest
 			<button onclick=\"for (var i = 0; i < mess.length; i++) mess[i].style.display = messagesVisible ? \'none\' : \'block\'; messagesVisible = !messagesVisible;\">Toggle messages</button>";
 		}
 		
+		inline void formatAssertionSites(std::vector<AssertionSite> const& sites) override
+		{
+			if (sites.empty()) return;
+			s << "<h2>Assertion sites</h2><table class='sites'>";
+			s << "<tr><th>Site</th><th>Expression</th><th>Reached</th><th>Passes</th><th>Fails</th><th>Time (µs)</th></tr>";
+			for (AssertionSite const& site : sites)
+			{
+				if (site.hits > 0 && !logPasses) continue;
+				s << "<tr class='" << (site.hits > 0 ? "reached" : "unreached") << "'><td>" << site.file << ":" << site.line << "</td>";
+				s << "<td><code>" << site.expr << "</code></td><td>" << (site.hits > 0 ? std::to_string(site.hits) : "never") << "</td>";
+				s << "<td>" << site.passes << "</td><td>" << site.fails << "</td><td>" << site.nanoseconds / 1e3 << "</td></tr>";
+			}
+			s << "</table>";
+		}
+		
 		inline void formatTestSuiteEnd(TestSuite const& suite) override
 		{
 			float prc = (float)suite.totalTestStats().passes / (suite.totalTestStats().passes + suite.totalTestStats().fails) * 100;
 			s << "<h2>Summary</h2>";
 			s << "<p>Total passed assertions: " << suite.totalTestStats().passes << "</p>";
 			s << "<p>Total failed assertions: " << suite.totalTestStats().fails <<  "</p>";
+			if (suite.totalTestStats().skippedTests > 0)
+				s << "<p>Skipped tests: " << suite.totalTestStats().skippedTests << "</p>";
+			if (suite.totalTestStats().nondeterministic > 0)
+				s << "<p>Nondeterministic tests: " << suite.totalTestStats().nondeterministic << "</p>";
+			if (suite.totalTestStats().sampled + suite.totalTestStats().skips > 0)
+				s << "<p>Sampled assertions: " << suite.totalTestStats().sampled << " evaluated, " << suite.totalTestStats().skips << " skipped</p>";
 			s << "<p>Success rate: " << prc << "%</p>";
 			s << "</div></body>";
 		}
+		
+		/** Closes the output and the test, then the page. */
+		inline std::string crashEpilogue() const override
+		{
+			return "</div></div></div></body>";
+		}
+	
+	};
+	
+	/** Class for formatting of test result output in a HTML format, logging everything. */
+	using TestResultFormatterHTML = BasicTestResultFormatterHTML<LogLevel::Everything>;
+	
+#pragma mark - Test Modules
+	
+	/**
+	 Description of a test in a module, filled in by `litest_module_test_info()`; see LT_MODULE.
+	 Part of the C interface of modules: fields are only ever added at the end, and the caller sets `size`
+	 so that a module fills in no more than the caller knows of.
+	 */
+	struct ModuleTestInfo
+	{
+		/** Size of the structure known to the caller, `sizeof(ModuleTestInfo)`. */
+		unsigned size;
+		
+		/** Name of the test; valid while the module is loaded. */
+		const char *name;
+		
+		/** File the test is defined in; valid while the module is loaded. */
+		const char *file;
+		
+		/** Names of the tests this test depends on; see TestSuite::addDependency(). Valid while the module is loaded. */
+		const char *const *dependencies;
+		
+		/** Number of `dependencies`. */
+		int dependencyCount;
+	};
+	
+	/**
+	 Result of a test run by `litest_module_run_test()`; see LT_MODULE.
+	 Part of the C interface of modules, extended like ModuleTestInfo.
+	 */
+	struct ModuleTestResult
+	{
+		/** Size of the structure known to the caller, `sizeof(ModuleTestResult)`. */
+		unsigned size;
+		
+		/** Number of passed assertions. */
+		long long passes;
+		
+		/** Number of failed assertions. */
+		long long fails;
+		
+		/** 1 if the test was aborted, otherwise 0. */
+		int aborted;
+		
+		/** Time taken to run the test, in seconds. */
+		double seconds;
+	};
 	
+	/** Formatter of a single test run by a module, without the header and summary of a suite. */
+	class TestResultFormatterModuleTest : public TestResultFormatterMarkdown<>
+	{
+	public:
+		
+		TestResultFormatterModuleTest(std::ostream &ostr)
+		: TestResultFormatterMarkdown<>(ostr) {}
+		
+		inline void formatTestSuiteStart(TestSuite const& suite) override {}
+		inline void formatCalibration(bench::Calibration const& calibration) override {}
+		inline void formatAssertionSites(std::vector<AssertionSite> const& sites) override {}
+		inline void formatTestSuiteEnd(TestSuite const& suite) override {}
 	};
+	
+#ifdef LITEST_POSIX
+	namespace internal
+	{
+		/**
+		 Describe a test of a module, for litest_module_test_info(); see LT_MODULE.
+		 @param suite The TestSuite of the module.
+		 @param index Index of the test.
+		 @param info Description to fill in, as far as its `size` allows.
+		 @return 0, or -1 if there is no such test.
+		 */
+		inline int moduleTestInfo(TestSuite &suite, int index, ModuleTestInfo *info)
+		{
+			if (index < 0 || index >= (int)suite.tests.size() || !info) return -1;
+			Test const& test = suite.tests[index];
+			if (LITEST_MODULE_HAS(info, name)) info->name = test.name.c_str();
+			if (LITEST_MODULE_HAS(info, file)) info->file = test.file.c_str();
+			if (LITEST_MODULE_HAS(info, dependencyCount))
+			{
+				static std::map<Test const*, std::vector<const char*>> names;
+				std::vector<const char*> &list = names[&test];
+				list.clear();
+				for (std::string const& dependency : test.dependencies) list.push_back(dependency.c_str());
+				info->dependencies = list.data();
+				info->dependencyCount = (int)list.size();
+			}
+			return 0;
+		}
+		
+		/**
+		 Run one test of a module, for litest_module_run_test(); see LT_MODULE.
+		 @param suite The TestSuite of the module.
+		 @param index Index of the test.
+		 @param fd File descriptor to write the report of the test to, in Markdown.
+		 @param result Result to fill in, as far as its `size` allows; may be `nullptr`.
+		 @return 0 if the test passed, 1 if it failed, or -1 if there is no such test.
+		 */
+		inline int runModuleTest(TestSuite &suite, int index, int fd, ModuleTestResult *result)
+		{
+			if (index < 0 || index >= (int)suite.tests.size()) return -1;
+			FdStreamBuf buf(fd, false);
+			std::ostream out(&buf);
+			auto start = std::chrono::steady_clock::now();
+			suite.runSome<TestResultFormatterModuleTest>(out, {index});
+			out.flush();
+			TestStats stats = suite.totalTestStats();
+			if (result)
+			{
+				if (LITEST_MODULE_HAS(result, passes)) result->passes = stats.passes;
+				if (LITEST_MODULE_HAS(result, fails)) result->fails = stats.fails;
+				if (LITEST_MODULE_HAS(result, aborted)) result->aborted = stats.aborted > 0;
+				if (LITEST_MODULE_HAS(result, seconds))
+					result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+			return stats.fails + stats.aborted > 0 ? 1 : 0;
+		}
+		
+		/**
+		 Whether a test is selected by a filter.
+		 @param name Name of the test.
+		 @param filter Comma-separated parts of test names; empty selects every test.
+		 @return `true` if the name contains any of the parts.
+		 */
+		inline bool testSelected(std::string const& name, std::string const& filter)
+		{
+			if (filter.empty()) return true;
+			std::stringstream ss(filter);
+			std::string part;
+			while (std::getline(ss, part, ','))
+				if (!part.empty() && name.find(part) != std::string::npos) return true;
+			return false;
+		}
+		
+		/**
+		 Run the selected tests of a module, for litest_module_run(); see LT_MODULE.
+		 @param suite The TestSuite of the module.
+		 @param filter Selected tests; see testSelected(). May be `nullptr`.
+		 @param fd File descriptor to write the report to, in Markdown.
+		 @return 0 if all selected tests passed, 1 otherwise.
+		 */
+		inline int runModule(TestSuite &suite, const char *filter, int fd)
+		{
+			std::vector<int> indexes;
+			for (size_t i = 0; i < suite.tests.size(); i++)
+				if (testSelected(suite.tests[i].name, filter ? filter : "")) indexes.push_back((int)i);
+			
+			FdStreamBuf buf(fd, false);
+			std::ostream out(&buf);
+			suite.runSome<TestResultFormatterMarkdown<>>(out, indexes);
+			out.flush();
+			return suite.totalTestStats().fails + suite.totalTestStats().aborted > 0 ? 1 : 0;
+		}
+	}
+#endif
 
 }
 
@@ -34,6 +34,10 @@
 #include <vector>
 #include <exception>
 #include <regex>
+#include <csignal>
+#include <sstream>
+#include <cstdio>
+#include <sys/wait.h>
 
 #include "litest.hpp"
 
@@ -62,9 +66,9 @@ public:
 	
 	virtual void formatTestSuiteEnd(litest::TestSuite const& suite)
 	{
-		int passes = suite.totalTestStats().passes;
-		int fails = suite.totalTestStats().fails;
-		int assertions = passes + fails;
+		long long passes = suite.totalTestStats().passes;
+		long long fails = suite.totalTestStats().fails;
+		long long assertions = passes + fails;
 		size_t test_cases = suite.tests.size();
 		
 		s << "\n===============================================================================\n";
@@ -102,6 +106,29 @@ struct NonPrintableType : TestType
 	NonPrintableType(int val = 0) : TestType(val) {}
 };
 
+// An input that is expensive to generate
+std::vector<int> primesBelow(int n)
+{
+	std::vector<bool> composite(n);
+	std::vector<int> primes;
+	for (int i = 2; i < n; i++)
+	{
+		if (composite[i]) continue;
+		primes.push_back(i);
+		for (long long j = (long long)i * i; j < n; j += i) composite[j] = true;
+	}
+	return primes;
+}
+
+// Code with a timeout, templated on its clock so that tests can control time
+template<typename Clock>
+struct Session
+{
+	typename Clock::time_point lastSeen = Clock::now();
+	
+	bool expired() const { return Clock::now() - lastSeen > std::chrono::minutes(5); }
+};
+
 
 /** The main function. */
 int main()
@@ -138,12 +165,20 @@ int main()
 	{
 		// Some failing assertions:
 		LT_CHECK(1 > 2);
+		
+		// The operand values of a failed check are reported:
+		int a = 7;
+		int b = 3;
+		LT_CHECK(a < b);
 		LT_EQUAL(1 + 1, 3);
 		LT_THROWS(1);
 		LT_EXCEPT(5 * 3, std::logic_error);
 		
 		// Add an assertion failure manually:
 		LT_FAIL("Some code went awry!");
+		
+		// Only the first failures of an assertion in a loop are reported, the rest are counted:
+		for (int i = 0; i < 1000; ++i) LT_CHECK(i < 5);
 	});
 	
 	LT_ADD_TEST(suite, "Test that is aborted early",
@@ -157,6 +192,42 @@ int main()
 		LT_CHECK(true);
 	});
 	
+	LT_ADD_TEST(suite, "Test that depends on another test",
+	{
+		LT_CHECK(true);
+	});
+	
+	// Only worth running if the test it depends on passed; this one will be skipped
+	suite.addDependency("Test that depends on another test", "Test that is aborted early");
+	
+	LT_ADD_TEST(suite, "Randomized test",
+	{
+		// Each test draws its own sequence from litest::rng(); the seed is reported if the test fails
+		std::uniform_int_distribution<int> die(1, 6);
+		int roll = die(litest::rng());
+		LT_CHECK(roll >= 1 && roll <= 6);
+		LT_EQUAL(roll, 7);
+	});
+	
+	LT_ADD_TEST(suite, "Test of a path that must not enter the kernel",
+	{
+		std::vector<int> squares(256);
+		
+		// The block runs in a child process that traps any system call
+		LT_NO_SYSCALLS({
+			for (size_t i = 0; i < squares.size(); i++) squares[i] = (int)(i * i);
+		});
+	});
+	
+	LT_ADD_TEST(suite, "Test of a path that enters the kernel",
+	{
+		// Flushing the output writes to the file descriptor, which is trapped and reported
+		LT_NO_SYSCALLS({
+			std::printf("logging from a real-time path\n");
+			std::fflush(stdout);
+		});
+	});
+	
 	LT_ADD_TEST(suite, "Test with throw outside of assertions",
 	{
 		LT_CHECK(INT_MAX > 5);
@@ -179,6 +250,73 @@ int main()
 		LT_EQUAL(nonPrintableA, nonPrintableB);
 	});
 	
+	LT_ADD_TEST(suite, "Test that writes output",
+	{
+		// With output capture, this is only reported because the test fails
+		std::cout << "Parsing input" << std::endl;
+		std::fprintf(stderr, "warning: input is empty\n");
+		LT_CHECK(std::string("").size() > 0);
+	});
+	
+	LT_ADD_TEST(suite, "Test with sampled assertions",
+	{
+		std::vector<int> squares(10000);
+		for (size_t i = 0; i < squares.size(); ++i) squares[i] = (int)(i * i);
+		
+		// Evaluate an assertion in a hot loop for about 1 in 100 iterations:
+		for (size_t i = 1; i < squares.size(); ++i) LT_CHECK_SAMPLED(squares[i] > squares[i - 1], 100);
+		
+		// Or start exhaustively and back off:
+		for (size_t i = 1; i < squares.size(); ++i) LT_CHECK_ADAPTIVE(squares[i] - squares[i - 1] == (int)(2 * i - 1), 1000);
+	});
+	
+	LT_ADD_TEST(suite, "Test with a virtual clock",
+	{
+		litest::VirtualClock::reset();
+		Session<litest::VirtualClock> session;
+		LT_CHECK(!session.expired());
+		
+		// No time passes for real
+		litest::VirtualClock::advance(std::chrono::minutes(6));
+		LT_CHECK(session.expired());
+		litest::VirtualClock::sleep_for(std::chrono::hours(1));
+		LT_CHECK(litest::VirtualClock::now().time_since_epoch() >= std::chrono::hours(1));
+	});
+	
+	LT_ADD_TEST(suite, "Test with eventual conditions",
+	{
+		std::atomic<int> done{0};
+		std::thread worker([&] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			done = 1;
+			// Wake the waiting assertion instead of letting it wait for its next poll
+			litest::wakeWaiters();
+		});
+		LT_EVENTUALLY(done == 1, std::chrono::seconds(5));
+		worker.join();
+		
+		// With fast-forward, a virtual minute passes in no time
+		litest::VirtualClock::reset();
+		litest::VirtualClock::setFastForward(true);
+		Session<litest::VirtualClock> session;
+		LT_EVENTUALLY(session.expired(), std::chrono::minutes(10));
+		litest::VirtualClock::reset();
+	});
+	
+	LT_ADD_TEST(suite, "Test with a cached input",
+	{
+		// Generated on the first run of this binary, then mapped from .litest-cache
+		auto primes = LT_CACHED_INPUT("primes", primesBelow(1000000));
+		LT_MESSAGE(primes.cached() ? "Primes read from the cache" : "Primes generated");
+		LT_EQUAL(primes.size(), 78498);
+		LT_CHECK(primes[0] == 2);
+		
+		// The second lookup in a run always finds the file the first one wrote
+		auto again = LT_CACHED_INPUT("primes", primesBelow(1000000));
+		LT_CHECK(again.cached());
+		LT_CHECK(std::equal(primes.begin(), primes.end(), again.begin()));
+	});
+	
 	// It is possble to bypass the C macros and use the C++ lambda interface.
 	// This results in a lot of boilerplate code.
 	// Macros are still needed to get file and line information.
@@ -207,8 +345,33 @@ int main()
 		// TODO: other tests here
 	});
 	
-	// Format output as HTML
-	std::ofstream outfile{"litest_example.html"};
+#ifdef LITEST_COROUTINES
+	// Async tests (C++20) wait for file descriptors, timers and futures without blocking each other
+	LT_ADD_ASYNC_TEST(suite, "Async test waiting for a timer and a future",
+	{
+		co_await litest::async::sleepFor(std::chrono::milliseconds(10));
+		auto answer = std::async(std::launch::async, [] { return 42; });
+		// Assertions evaluate their expressions in lambdas, so await before asserting
+		int value = co_await litest::async::ready(answer);
+		LT_EQUAL(value, 42);
+	});
+#endif
+	
+#ifdef LITEST_SANITIZER_HOOKS
+	// Sanitizer reports are attributed to the running test, which is reported as aborted;
+	// this is the hook the sanitizer runtimes call with the summary line of each report
+	LT_ADD_TEST(suite, "Test with a sanitizer report",
+	{
+		LT_CHECK(true);
+		__sanitizer_report_error_summary("SUMMARY: ExampleSanitizer: made-up-error test/test.cpp in main()");
+	});
+#endif
+	
+	// Capture what tests write to stdout and stderr, and report it for failed tests
+	suite.captureOutput = litest::TestSuite::Capture::OnFailure;
+	
+	// Format output as HTML, into a file that the report can be completed in after a crash
+	litest::ReportFile outfile{"litest_example.html"};
 	suite.run<litest::TestResultFormatterHTML>(outfile);
 	
 	// Or Markdown
@@ -216,4 +379,124 @@ int main()
 	
 	// Or add your own formatter
 	suite.run<MyCustomTestResultFormatter>(std::cout);
+	
+	// Benchmarks go in a suite of their own, which measures the machine at the start of its run,
+	// so that benchmark results can be compared across hosts
+	litest::TestSuite benchmarks("LiTest benchmarks");
+	benchmarks.calibrate = true;
+	
+	LT_ADD_TEST(benchmarks, "Test with a benchmark",
+	{
+		std::vector<int> vec(1000, 1);
+		
+		// Measure the running time of a block; the machine is inspected before the first benchmark:
+		LT_BENCHMARK("Sum of 1000 ints",
+		{
+			litest::bench::doNotOptimize(std::accumulate(vec.begin(), vec.end(), 0));
+		});
+		
+		// Measure cache and TLB effects over working-set sizes and strides:
+		std::vector<size_t> sizes = litest::bench::sweepSizes(16 << 10, 64 << 10);
+		std::vector<size_t> strides(1, 64);
+		strides.push_back(4096);
+		LT_BENCHMARK_SWEEP("Strided reads", sizes, strides, [] (litest::bench::Buffer &buffer, size_t size, size_t stride)
+		{
+			char sum = 0;
+			for (size_t offset = 0; offset < size; offset += stride) sum += buffer.as<char>()[offset];
+			litest::bench::doNotOptimize(sum);
+		});
+	});
+	
+	benchmarks.run<litest::TestResultFormatterMarkdown<>>(std::cout);
+	
+	// Each test of this suite runs three times, and fails if its assertions differ between the runs
+	litest::TestSuite repeated("LiTest determinism checks");
+	repeated.determinismRuns = 3;
+	int calls = 0;
+	
+	LT_ADD_TEST(repeated, "Deterministic test",
+	{
+		std::vector<int> squares;
+		for (int i = 0; i < 10; i++) squares.push_back(i * i);
+		LT_EQUAL(squares.back(), 81);
+	});
+	
+	LT_ADD_TEST(repeated, "Nondeterministic test",
+	{
+		// Passes in the reported run only
+		LT_CHECK(++calls == 1);
+	});
+	
+	repeated.run<litest::TestResultFormatterMarkdown<>>(std::cout);
+	
+	// If a test crashes, report it as aborted and continue with the next one in a re-executed process
+	litest::TestSuite crashes("LiTest crash handling");
+	crashes.crashHandling = litest::TestSuite::CrashHandling::Resume;
+	
+	LT_ADD_TEST(crashes, "Test that passes before a crash",
+	{
+		LT_CHECK(true);
+	});
+	
+	LT_ADD_TEST(crashes, "Test that crashes",
+	{
+		LT_CHECK(true);
+		std::raise(SIGSEGV);
+	});
+	
+	LT_ADD_TEST(crashes, "Test that runs after a crash",
+	{
+		LT_CHECK(true);
+	});
+	
+	// The resumed process skips the tests before the crash, but knows that they passed
+	crashes.addDependency("Test that runs after a crash", "Test that passes before a crash");
+	
+	crashes.run<litest::TestResultFormatterMarkdown<>>(std::cout);
+	
+#ifdef LITEST_POSIX
+	// A checkpointed run appends each completed test to a journal, and a run resumed from the journal
+	// replays the completed tests instead of running them again; here a child process is interrupted
+	litest::TestSuite checkpointed("LiTest checkpoints");
+	checkpointed.checkpointFile = "litest_example.journal";
+	bool interrupt = false;
+	int completedRuns = 0;
+	
+	LT_ADD_TEST(checkpointed, "Test completed before the interruption",
+	{
+		completedRuns++;
+		LT_EQUAL(1 + 1, 3);
+	});
+	
+	LT_ADD_TEST(checkpointed, "Test that is interrupted",
+	{
+		if (interrupt) _exit(0);
+		
+		// The completed test only ran in the interrupted process, and was replayed from the journal in this one
+		LT_EQUAL(completedRuns, 0);
+	});
+	
+	LT_ADD_TEST(checkpointed, "Test that depends on a replayed test",
+	{
+		LT_CHECK(true);
+	});
+	
+	// Skipped when resumed, as the replayed test is known to have failed
+	checkpointed.addDependency("Test that depends on a replayed test", "Test completed before the interruption");
+	
+	std::cout.flush();
+	pid_t child = fork();
+	if (child == 0)
+	{
+		interrupt = true;
+		std::ostringstream discarded;
+		checkpointed.run<litest::TestResultFormatterMarkdown<>>(discarded);
+		_exit(1);
+	}
+	waitpid(child, nullptr, 0);
+	
+	checkpointed.resumeFromCheckpoint = true;
+	checkpointed.run<litest::TestResultFormatterMarkdown<>>(std::cout);
+	std::remove("litest_example.journal");
+#endif
 }
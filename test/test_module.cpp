@@ -0,0 +1,65 @@
+/**
+ @file
+ @brief Example of a LiTest test module, run by litest-server.
+ @author  August Ernstsson <augern@icloud.com>
+ @version 1.0
+ 
+ @section LICENSE
+ Copyright (c) 2015 August Ernstsson.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ - The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ **THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.**
+ 
+ @section DESCRIPTION
+ 
+ Build with `make bin/test_module.so`, then run `bin/litest-server bin/test_module.so`
+ and `bin/litest-client` in another terminal.
+ */
+
+#include "litest.hpp"
+
+#include <numeric>
+
+/** A fixture that is expensive to set up, and stays set up while the module is loaded. */
+static std::vector<int> const& table()
+{
+	static std::vector<int> values = [] {
+		std::vector<int> v(1 << 20);
+		std::iota(v.begin(), v.end(), 0);
+		return v;
+	}();
+	return values;
+}
+
+LT_MODULE("Module tests")
+{
+	LT_ADD_TEST(suite, "Table lookups",
+	{
+		LT_EQUAL(table()[42], 42);
+		LT_CHECK(table().size() == 1u << 20);
+	});
+	
+	LT_ADD_TEST(suite, "Table sums",
+	{
+		long long sum = std::accumulate(table().begin(), table().begin() + 100, 0LL);
+		LT_EQUAL(sum, 4950);
+	});
+	
+	// Sums are only checked if lookups work
+	suite.addDependency("Table sums", "Table lookups");
+}
@@ -0,0 +1,115 @@
+/**
+ @file
+ @brief litest-client, the command line client of litest-server.
+ @author  August Ernstsson <augern@icloud.com>
+ @version 1.0
+ 
+ @section LICENSE
+ Copyright (c) 2015 August Ernstsson.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ - The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ **THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.**
+ 
+ @section DESCRIPTION
+ 
+ Sends a request to litest-server and prints the report.
+ 
+ Usage: `litest-client [-s socket] [-w] [--quit] [filter]`
+ 
+ Runs the tests selected by `filter` (see litest-server) and exits with status 0 if they passed.
+ With `-w`, keeps running them each time the server reloads a module, until interrupted.
+ */
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/** Print usage information. */
+static void usage(const char *prog)
+{
+	std::cerr << "Usage: " << prog << " [-s socket] [-w] [--quit] [filter]" << std::endl;
+}
+
+/** The main function. */
+int main(int argc, char *argv[])
+{
+	std::string socketPath = ".litest-server.sock";
+	std::string command = "run";
+	std::string filter;
+	
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-s" && i + 1 < argc) socketPath = argv[++i];
+		else if (arg == "-w") command = "watch";
+		else if (arg == "--quit") command = "quit";
+		else if (arg == "-h" || arg == "--help") { usage(argv[0]); return 0; }
+		else if (!arg.empty() && arg[0] == '-') { usage(argv[0]); return 2; }
+		else filter = arg;
+	}
+	
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	std::strncpy(addr.sun_path, socketPath.c_str(), sizeof addr.sun_path - 1);
+	if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof addr) != 0)
+	{
+		std::cerr << "litest-client: cannot connect to " << socketPath << ": " << strerror(errno) << std::endl;
+		return 2;
+	}
+	
+	std::string request = command + (filter.empty() ? "" : " " + filter) + "\n";
+	if (write(fd, request.data(), request.size()) != (ssize_t)request.size()) return 2;
+	
+	// Print the report, and turn the status line ending each run into a summary
+	int status = command == "quit" ? 0 : 2;
+	std::string line;
+	char buf[65536];
+	ssize_t n;
+	while ((n = read(fd, buf, sizeof buf)) != 0)
+	{
+		if (n < 0) { if (errno == EINTR) continue; break; }
+		line.append(buf, n);
+		size_t pos;
+		while ((pos = line.find('\n')) != std::string::npos)
+		{
+			std::string text = line.substr(0, pos);
+			line.erase(0, pos + 1);
+			if (text.compare(0, 15, "#litest-server\t") == 0)
+			{
+				std::stringstream ss(text.substr(15));
+				int failed = 1;
+				double ms = 0;
+				ss >> failed >> ms;
+				status = failed ? 1 : 0;
+				std::cout << "- Server run " << (failed ? "**failed**" : "passed") << " in " << ms << " ms" << std::endl;
+			}
+			else std::cout << text << std::endl;
+		}
+	}
+	std::cout << line;
+	close(fd);
+	return status;
+}
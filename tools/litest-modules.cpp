@@ -0,0 +1,775 @@
+/**
+ @file
+ @brief litest-modules, a runner that aggregates LiTest modules on one worker pool.
+ @author  August Ernstsson <augern@icloud.com>
+ @version 1.0
+ 
+ @section LICENSE
+ Copyright (c) 2015 August Ernstsson.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ - The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ **THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.**
+ 
+ @section DESCRIPTION
+ 
+ Loads test modules (shared objects defined with LT_MODULE) into one process and runs the tests of all of them
+ on a shared pool of workers, then prints one report.
+ 
+ Usage: `litest-modules [-j jobs] [-t filter] [--seed seed] [--time-budget seconds] [--history file] module.so...`
+ 
+ The modules are loaded through their C interface, so they can be rebuilt and relinked independently of each
+ other and of the runner. The runner then forks its workers, which inherit the loaded modules. Tests are handed
+ out one at a time to idle workers, whatever module they belong to, so one slow module does not hold up the
+ rest. Each worker writes its reports to an in-memory file that the runner reads back. A worker that dies takes
+ only its current test with it; the test is reported as aborted and a new worker is started.
+ 
+ Tests start only after the tests they depend on (see litest::TestSuite::addDependency()) have passed, so
+ independent parts of the dependency graph run in parallel. Tests whose dependencies failed are skipped.
+ 
+ `-t` selects the tests whose names contain one of its comma-separated parts.
+ `--seed` sets the seed of litest::rng(), to replay a failure of a randomized test. Each test draws the same
+ numbers whichever worker runs it.
+ 
+ With `--time-budget` or `--history`, the duration and outcome of every test are recorded in a history file,
+ `.litest-history` unless given with `--history`. With `--time-budget`, only the tests expected to find the most
+ failures per second of test time are run, as far as their recorded durations fit in the budget on all workers.
+ A test longer than the budget, or whose chain of dependencies is, is never chosen.
+ The chance that a test fails is estimated from its recent failures, and raised if its source file changed since
+ it last ran; tests without a history always run first. The tests left out are listed after the report.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <map>
+#include <random>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "litest.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+/** A loaded test module and its entry points; see LT_MODULE. */
+struct Module
+{
+	/** Path of the shared object. */
+	std::string path;
+	
+	/** Name of the suite in the module. */
+	std::string name;
+	
+	/** Entry points. */
+	int (*testInfo)(int, litest::ModuleTestInfo*) = nullptr;
+	int (*runTest)(int, int, litest::ModuleTestResult*) = nullptr;
+	
+	/** Names of the tests. */
+	std::vector<std::string> tests;
+	
+	/** Source files of the tests. */
+	std::vector<std::string> files;
+	
+	/** Names of the tests each test depends on. */
+	std::vector<std::vector<std::string>> dependencies;
+	
+	/**
+	 Load the module and list its tests.
+	 @return Empty string on success, otherwise the error.
+	 */
+	std::string load()
+	{
+		void *handle = dlopen(this->path.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (!handle) return dlerror();
+		auto version = (unsigned (*)())dlsym(handle, "litest_module_abi_version");
+		auto name = (const char *(*)())dlsym(handle, "litest_module_name");
+		auto count = (int (*)())dlsym(handle, "litest_module_test_count");
+		this->testInfo = (int (*)(int, litest::ModuleTestInfo*))dlsym(handle, "litest_module_test_info");
+		this->runTest = (int (*)(int, int, litest::ModuleTestResult*))dlsym(handle, "litest_module_run_test");
+		if (!version || !name || !count || !this->testInfo || !this->runTest) return "not a test module (LT_MODULE)";
+		if (version() != LITEST_MODULE_ABI_VERSION)
+			return "module interface version " + std::to_string(version()) + ", expected " + std::to_string(LITEST_MODULE_ABI_VERSION);
+		
+		this->name = name();
+		for (int i = 0, n = count(); i < n; i++)
+		{
+			litest::ModuleTestInfo info;
+			std::memset(&info, 0, sizeof info);
+			info.size = sizeof info;
+			this->testInfo(i, &info);
+			this->tests.push_back(info.name ? info.name : "");
+			this->files.push_back(info.file ? info.file : "");
+			this->dependencies.emplace_back();
+			for (int d = 0; d < info.dependencyCount; d++) this->dependencies.back().push_back(info.dependencies[d]);
+		}
+		return "";
+	}
+};
+
+/** A test to run, and its result. */
+struct Job
+{
+	/** Module and index of the test. */
+	int module;
+	int test;
+	
+	/** Result reported by the worker. */
+	litest::ModuleTestResult result;
+	
+	/** Report of the test. */
+	std::string report;
+	
+	/** Jobs of the selected tests this test depends on. */
+	std::vector<int> dependsOn;
+	
+	/** Name of a dependency that does not exist, if any. */
+	std::string missing;
+	
+	/** Whether the test was handed to a worker or skipped. */
+	bool started = false;
+	
+	/** Whether the test has run or was skipped. */
+	bool done = false;
+	
+	/** "passed", "failed" or "skipped", once done. */
+	std::string outcome;
+	
+	/** Estimated duration in seconds and probability of failure, when running within a time budget. */
+	double estimate = 0;
+	double probability = 1;
+	
+	/**
+	 Mark the test as skipped.
+	 @param module The module of the test.
+	 @param reason Why the test is skipped.
+	 */
+	void skip(Module const& module, std::string const& reason)
+	{
+		std::stringstream ss;
+		ss << std::endl << " Test " << this->test + 1 << ": *" << module.tests[this->test] << "*" << std::endl;
+		ss << "------------------------------------------------" << std::endl;
+		ss << "- **Skipped: " << reason << "**" << std::endl;
+		this->report = ss.str();
+		std::memset(&this->result, 0, sizeof this->result);
+		this->started = this->done = true;
+		this->outcome = "skipped";
+	}
+};
+
+/** Durations and outcomes of the tests in earlier runs. */
+struct History
+{
+	/** Weight of each run relative to the one after it. */
+	static constexpr double decay = 0.8;
+	
+	/** Record of one test. */
+	struct Entry
+	{
+		/** Number of runs and of failures, weighted by decay to the power of their age. */
+		double runs = 0;
+		double failures = 0;
+		
+		/** Duration in seconds, averaged towards the recent runs. */
+		double seconds = 0;
+		
+		/** Time of the last run. */
+		time_t lastRun = 0;
+	};
+	
+	/** Records, by module and test name. */
+	std::map<std::string, Entry> entries;
+	
+	/** Key of a test in the history. */
+	static std::string key(Module const& module, int test)
+	{
+		return module.name + "\t" + module.tests[test];
+	}
+	
+	/**
+	 Read the history from a file; a missing file is an empty history.
+	 @param path Path of the file.
+	 */
+	void load(std::string const& path)
+	{
+		std::ifstream in(path);
+		std::string line;
+		while (std::getline(in, line))
+		{
+			// module \t test \t runs \t failures \t seconds \t last run
+			std::vector<std::string> fields;
+			std::stringstream ss(line);
+			std::string field;
+			while (std::getline(ss, field, '\t')) fields.push_back(field);
+			if (fields.size() != 6) continue;
+			Entry &entry = this->entries[fields[0] + "\t" + fields[1]];
+			entry.runs = std::atof(fields[2].c_str());
+			entry.failures = std::atof(fields[3].c_str());
+			entry.seconds = std::atof(fields[4].c_str());
+			entry.lastRun = (time_t)std::atoll(fields[5].c_str());
+		}
+	}
+	
+	/**
+	 Write the history to a file, replacing it at once.
+	 @param path Path of the file.
+	 @return `true` on success.
+	 */
+	bool save(std::string const& path) const
+	{
+		// Only a regular file is replaced; anything else, such as /dev/null, is written to
+		struct stat st;
+		bool replace = stat(path.c_str(), &st) != 0 || S_ISREG(st.st_mode);
+		std::string temporary = replace ? path + ".tmp" : path;
+		{
+			std::ofstream out(temporary);
+			out << std::setprecision(6);
+			for (auto const& record : this->entries)
+				out << record.first << "\t" << record.second.runs << "\t" << record.second.failures << "\t"
+					<< record.second.seconds << "\t" << (long long)record.second.lastRun << "\n";
+			if (!out.flush()) return false;
+		}
+		return !replace || std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+	
+	/**
+	 Add a run of a test.
+	 @param key Key of the test.
+	 @param seconds Duration of the run.
+	 @param failed Whether the test failed.
+	 @param now Time of the run.
+	 */
+	void record(std::string const& key, double seconds, bool failed, time_t now)
+	{
+		Entry &entry = this->entries[key];
+		entry.seconds = entry.runs > 0 ? 0.5 * entry.seconds + 0.5 * seconds : seconds;
+		entry.runs = entry.runs * decay + 1;
+		entry.failures = entry.failures * decay + (failed ? 1 : 0);
+		entry.lastRun = now;
+	}
+};
+
+/**
+ Last modification time of the source of a test, or else of its module.
+ @param module The module.
+ @param test Index of the test.
+ */
+static time_t changeTime(Module const& module, int test)
+{
+	struct stat st;
+	if (stat(module.files[test].c_str(), &st) == 0 || stat(module.path.c_str(), &st) == 0) return st.st_mtime;
+	return 0;
+}
+
+/**
+ Choose the tests to run within a time budget. The tests are taken in order of their estimated probability
+ of failure per second, each together with the tests it depends on, as long as they fit: each test is given to
+ the worker that is free first, after its dependencies are expected to finish, and must be expected to finish
+ within the budget. A test that takes longer than the budget, alone or after its dependencies, is left out.
+ @param modules The modules.
+ @param jobs The selected tests; the ones left out are removed.
+ @param history Recorded runs.
+ @param budget Seconds of wall time available.
+ @param workerCount Number of workers.
+ @return The jobs that were left out.
+ */
+static std::vector<Job> applyBudget(std::vector<Module> const& modules, std::vector<Job> &jobs, History const& history, double budget, size_t workerCount)
+{
+	// Tests that never ran are assumed to take as long as the median of those that did
+	std::vector<double> known;
+	for (Job const& job : jobs)
+	{
+		auto entry = history.entries.find(History::key(modules[job.module], job.test));
+		if (entry != history.entries.end()) known.push_back(entry->second.seconds);
+	}
+	std::sort(known.begin(), known.end());
+	double unknown = known.empty() ? 1.0 : known[known.size() / 2];
+	
+	for (Job &job : jobs)
+	{
+		auto entry = history.entries.find(History::key(modules[job.module], job.test));
+		if (entry == history.entries.end())
+		{
+			job.estimate = unknown;
+			job.probability = 1;
+			continue;
+		}
+		// One failure in ten runs before there is any evidence; a changed source file doubles the odds of failing
+		History::Entry const& record = entry->second;
+		job.estimate = record.seconds;
+		job.probability = (record.failures + 0.1) / (record.runs + 1);
+		if (changeTime(modules[job.module], job.test) > record.lastRun) job.probability = 1 - (1 - job.probability) * 0.5;
+	}
+	
+	std::vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return jobs[a].probability / std::max(jobs[a].estimate, 1e-3) > jobs[b].probability / std::max(jobs[b].estimate, 1e-3);
+	});
+	
+	// Dependencies among the selected tests
+	std::vector<std::vector<size_t>> dependsOn(jobs.size());
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		Module const& module = modules[jobs[i].module];
+		for (std::string const& dependency : module.dependencies[jobs[i].test])
+			for (size_t j = 0; j < jobs.size(); j++)
+				if (jobs[j].module == jobs[i].module && module.tests[jobs[j].test] == dependency) dependsOn[i].push_back(j);
+	}
+	
+	// Expected time at which each worker is free, and each chosen test finishes
+	std::vector<bool> chosen(jobs.size());
+	std::vector<double> load(workerCount), finish(jobs.size());
+	for (size_t first : order)
+	{
+		// The test and its dependencies that are not chosen yet, dependencies first
+		std::vector<size_t> needed;
+		std::vector<bool> visited(jobs.size());
+		std::vector<std::pair<size_t, bool>> pending = { { first, false } };
+		while (!pending.empty())
+		{
+			std::pair<size_t, bool> top = pending.back();
+			pending.pop_back();
+			if (top.second) { needed.push_back(top.first); continue; }
+			if (chosen[top.first] || visited[top.first]) continue;
+			visited[top.first] = true;
+			pending.emplace_back(top.first, true);
+			for (size_t d : dependsOn[top.first]) pending.emplace_back(d, false);
+		}
+		if (needed.empty()) continue;
+		
+		// Tests in a dependency cycle count as ready at the start; the runner skips them anyway
+		std::vector<double> trial = load;
+		bool fits = true;
+		for (size_t i : needed)
+		{
+			double ready = 0;
+			for (size_t d : dependsOn[i]) ready = std::max(ready, finish[d]);
+			auto worker = std::min_element(trial.begin(), trial.end());
+			finish[i] = std::max(*worker, ready) + jobs[i].estimate;
+			*worker = finish[i];
+			if (finish[i] > budget) { fits = false; break; }
+		}
+		if (!fits)
+		{
+			for (size_t i : needed) finish[i] = 0;
+			continue;
+		}
+		for (size_t i : needed) chosen[i] = true;
+		load.swap(trial);
+	}
+	
+	std::vector<Job> kept, left;
+	for (size_t i = 0; i < jobs.size(); i++) (chosen[i] ? kept : left).push_back(jobs[i]);
+	jobs.swap(kept);
+	return left;
+}
+
+/**
+ Find the next test to run: the first one whose dependencies have passed.
+ Skips the tests whose dependencies did not pass on the way.
+ @param modules The modules.
+ @param jobs The jobs.
+ @param done Number of finished jobs; increased by the skipped ones.
+ @return Index of the job, or -1 if no test can start now.
+ */
+static int nextJob(std::vector<Module> const& modules, std::vector<Job> &jobs, size_t &done)
+{
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		Job &job = jobs[i];
+		if (job.started) continue;
+		Module const& module = modules[job.module];
+		std::string reason = job.missing.empty() ? "" : "dependency " + job.missing + " does not exist";
+		bool ready = true;
+		for (int d : job.dependsOn)
+		{
+			if (!jobs[d].done) ready = false;
+			else if (jobs[d].outcome != "passed" && reason.empty())
+				reason = "dependency " + module.tests[jobs[d].test] + " " + jobs[d].outcome;
+		}
+		if (!reason.empty())
+		{
+			// Restart the scan, as skipping may decide the fate of earlier tests
+			job.skip(module, reason);
+			done++;
+			i = (size_t)-1;
+			continue;
+		}
+		if (ready) return (int)i;
+	}
+	return -1;
+}
+
+/** Message from a worker after running a job. */
+struct Finished
+{
+	/** Index of the job. */
+	int job;
+	
+	/** Result of the test. */
+	litest::ModuleTestResult result;
+	
+	/** Position and length of the report in the report file of the worker. */
+	off_t offset;
+	off_t length;
+};
+
+/** A worker process. */
+struct Worker
+{
+	pid_t pid = -1;
+	
+	/** Pipe to send job indexes to. */
+	int jobs = -1;
+	
+	/** Pipe to receive Finished messages from. */
+	int results = -1;
+	
+	/** In-memory file the reports are written to. */
+	int reports = -1;
+	
+	/** Job being run, or -1 if idle. */
+	int job = -1;
+	
+	/** Time the current job started. */
+	Clock::time_point started;
+};
+
+/**
+ Body of a worker process: runs jobs until its job pipe is closed.
+ @param modules The modules.
+ @param jobs The jobs.
+ @param worker The worker.
+ */
+static void work(std::vector<Module> const& modules, std::vector<Job> const& jobs, Worker const& worker)
+{
+	int index;
+	while (read(worker.jobs, &index, sizeof index) == sizeof index)
+	{
+		Job const& job = jobs[index];
+		Finished finished;
+		std::memset(&finished, 0, sizeof finished);
+		finished.job = index;
+		finished.result.size = sizeof finished.result;
+		finished.offset = lseek(worker.reports, 0, SEEK_END);
+		modules[job.module].runTest(job.test, worker.reports, &finished.result);
+		finished.length = lseek(worker.reports, 0, SEEK_END) - finished.offset;
+		if (write(worker.results, &finished, sizeof finished) != sizeof finished) break;
+	}
+}
+
+/**
+ Start a worker.
+ @param modules The modules.
+ @param jobs The jobs.
+ @param workers All workers.
+ @param worker The worker to start.
+ @return `true` if a process was created.
+ */
+static bool spawn(std::vector<Module> const& modules, std::vector<Job> const& jobs, std::vector<Worker> const& workers, Worker &worker)
+{
+	int jobPipe[2], resultPipe[2];
+	if (pipe2(jobPipe, O_CLOEXEC) != 0) return false;
+	if (pipe2(resultPipe, O_CLOEXEC) != 0) { close(jobPipe[0]); close(jobPipe[1]); return false; }
+	worker.reports = memfd_create("litest-modules", MFD_CLOEXEC);
+	
+	std::cout.flush();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		// Only the runner may hold the pipes of other workers, or they would not see their job pipe close
+		for (Worker const& other : workers)
+			if (&other != &worker && other.pid > 0)
+			{
+				close(other.jobs);
+				close(other.results);
+				close(other.reports);
+			}
+		close(jobPipe[1]);
+		close(resultPipe[0]);
+		worker.jobs = jobPipe[0];
+		worker.results = resultPipe[1];
+		work(modules, jobs, worker);
+		_exit(0);
+	}
+	close(jobPipe[0]);
+	close(resultPipe[1]);
+	worker.pid = pid;
+	worker.jobs = jobPipe[1];
+	worker.results = resultPipe[0];
+	worker.job = -1;
+	return pid > 0;
+}
+
+/**
+ Stop a worker and release its resources.
+ @param worker The worker.
+ @return Wait status of the process.
+ */
+static int reap(Worker &worker)
+{
+	int status = 0;
+	close(worker.jobs);
+	close(worker.results);
+	close(worker.reports);
+	if (worker.pid > 0) waitpid(worker.pid, &status, 0);
+	worker = Worker();
+	return status;
+}
+
+/** Print usage information. */
+static void usage(const char *prog)
+{
+	std::cerr << "Usage: " << prog << " [-j jobs] [-t filter] [--seed seed] [--time-budget seconds] [--history file] module.so..." << std::endl;
+}
+
+/** The main function. */
+int main(int argc, char *argv[])
+{
+	int workerCount = std::max(1u, std::thread::hardware_concurrency());
+	std::string filter;
+	std::string historyPath;
+	double budget = 0;
+	std::vector<Module> modules;
+	
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc) workerCount = std::max(1, std::atoi(argv[++i]));
+		else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) workerCount = std::max(1, std::atoi(arg.c_str() + 2));
+		else if (arg == "-t" && i + 1 < argc) filter = argv[++i];
+		else if (arg == "--seed" && i + 1 < argc) setenv(LITEST_SEED_ENV, argv[++i], 1);
+		else if (arg == "--time-budget" && i + 1 < argc) budget = std::atof(argv[++i]);
+		else if (arg == "--history" && i + 1 < argc) historyPath = argv[++i];
+		else if (arg == "-h" || arg == "--help") { usage(argv[0]); return 0; }
+		else if (!arg.empty() && arg[0] == '-') { usage(argv[0]); return 2; }
+		else
+		{
+			modules.emplace_back();
+			modules.back().path = arg.find('/') == std::string::npos ? "./" + arg : arg;
+		}
+	}
+	if (modules.empty()) { usage(argv[0]); return 2; }
+	
+	// One seed for all workers, unless given; suites with a seed of their own keep it
+	if (!getenv(LITEST_SEED_ENV) && !getenv(LITEST_AUTO_SEED_ENV))
+	{
+		std::random_device device;
+		std::stringstream ss;
+		ss << "0x" << std::hex << (((uint64_t)device() << 32) | device());
+		setenv(LITEST_AUTO_SEED_ENV, ss.str().c_str(), 1);
+	}
+	
+	for (Module &module : modules)
+	{
+		std::string error = module.load();
+		if (!error.empty())
+		{
+			std::cerr << "litest-modules: " << module.path << ": " << error << std::endl;
+			return 2;
+		}
+	}
+	
+	std::vector<Job> jobs;
+	for (size_t m = 0; m < modules.size(); m++)
+		for (size_t t = 0; t < modules[m].tests.size(); t++)
+			if (litest::internal::testSelected(modules[m].tests[t], filter))
+			{
+				jobs.emplace_back();
+				jobs.back().module = (int)m;
+				jobs.back().test = (int)t;
+			}
+	
+	// The history is only kept when it is asked for, or needed to choose tests
+	bool useHistory = budget > 0 || !historyPath.empty();
+	if (historyPath.empty()) historyPath = ".litest-history";
+	History history;
+	if (useHistory) history.load(historyPath);
+	size_t workerTotal = std::min<size_t>(workerCount, std::max<size_t>(1, jobs.size()));
+	std::vector<Job> left;
+	if (budget > 0) left = applyBudget(modules, jobs, history, budget, workerTotal);
+	
+	// Dependencies are by name, within a module; those on tests that are not selected are ignored
+	for (Job &job : jobs)
+	{
+		Module const& module = modules[job.module];
+		for (std::string const& dependency : module.dependencies[job.test])
+		{
+			if (std::find(module.tests.begin(), module.tests.end(), dependency) == module.tests.end()) { job.missing = dependency; continue; }
+			for (size_t j = 0; j < jobs.size(); j++)
+				if (jobs[j].module == job.module && module.tests[jobs[j].test] == dependency) job.dependsOn.push_back((int)j);
+		}
+	}
+	
+	signal(SIGPIPE, SIG_IGN);
+	auto runStart = Clock::now();
+	std::vector<Worker> workers(workerTotal);
+	size_t done = 0;
+	double testTime = 0;
+	
+	while (done < jobs.size())
+	{
+		// Hand out a job to every idle worker
+		for (Worker &worker : workers)
+		{
+			if (worker.job >= 0) continue;
+			int index = nextJob(modules, jobs, done);
+			if (index < 0) break;
+			if (worker.pid <= 0 && !spawn(modules, jobs, workers, worker)) { perror("litest-modules: fork"); return 2; }
+			jobs[index].started = true;
+			worker.job = index;
+			worker.started = Clock::now();
+			if (write(worker.jobs, &index, sizeof index) != sizeof index) { /* The worker died; noticed below */ }
+		}
+		
+		std::vector<pollfd> pfds;
+		std::vector<Worker*> polled;
+		for (Worker &worker : workers)
+			if (worker.job >= 0)
+			{
+				pfds.push_back({ worker.results, POLLIN, 0 });
+				polled.push_back(&worker);
+			}
+		if (pfds.empty())
+		{
+			// Nothing runs and nothing can start: the remaining tests wait for each other
+			std::vector<std::pair<int, int>> waiting;
+			for (size_t i = 0; i < jobs.size(); i++)
+				if (!jobs[i].started)
+					waiting.emplace_back((int)i, *std::find_if(jobs[i].dependsOn.begin(), jobs[i].dependsOn.end(), [&](int d) { return !jobs[d].done; }));
+			for (auto const& wait : waiting)
+			{
+				Module const& module = modules[jobs[wait.first].module];
+				jobs[wait.first].skip(module, "dependency " + module.tests[jobs[wait.second].test] + " is in a cycle with this test");
+				done++;
+			}
+			break;
+		}
+		if (poll(pfds.data(), pfds.size(), -1) < 0) continue;
+		
+		for (size_t i = 0; i < pfds.size(); ++i)
+		{
+			if (!pfds[i].revents) continue;
+			Worker &worker = *polled[i];
+			Finished finished;
+			ssize_t n = read(worker.results, &finished, sizeof finished);
+			if (n < 0 && errno == EINTR) continue;
+			
+			Job &job = jobs[worker.job];
+			if (n == sizeof finished)
+			{
+				job.result = finished.result;
+				job.report.resize(finished.length);
+				if (pread(worker.reports, &job.report[0], finished.length, finished.offset) != finished.length) job.report.clear();
+			}
+			else
+			{
+				// The worker died in the test
+				double seconds = std::chrono::duration<double>(Clock::now() - worker.started).count();
+				int status = reap(worker);
+				std::stringstream ss;
+				ss << std::endl << " Test " << job.test + 1 << ": *" << modules[job.module].tests[job.test] << "*" << std::endl;
+				ss << "------------------------------------------------" << std::endl;
+				ss << "- **Test aborted: worker ";
+				if (WIFSIGNALED(status)) ss << "killed by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+				else ss << "exited with status " << WEXITSTATUS(status);
+				ss << "**" << std::endl;
+				job.report = ss.str();
+				std::memset(&job.result, 0, sizeof job.result);
+				job.result.aborted = 1;
+				job.result.seconds = seconds;
+			}
+			testTime += job.result.seconds;
+			job.outcome = job.result.aborted || job.result.fails > 0 ? "failed" : "passed";
+			job.done = true;
+			worker.job = -1;
+			done++;
+		}
+	}
+	for (Worker &worker : workers) if (worker.pid > 0) reap(worker);
+	double wall = std::chrono::duration<double>(Clock::now() - runStart).count();
+	
+	if (useHistory)
+	{
+		time_t now = std::time(nullptr);
+		for (Job const& job : jobs)
+			if (job.outcome != "skipped") history.record(History::key(modules[job.module], job.test), job.result.seconds, job.outcome == "failed", now);
+		if (!history.save(historyPath)) std::cerr << "litest-modules: cannot write " << historyPath << std::endl;
+	}
+	
+	// Report, in the order of the modules and their tests
+	long long tests = 0, aborted = 0, skipped = 0, passes = 0, fails = 0;
+	int failedModules = 0;
+	for (size_t m = 0; m < modules.size(); m++)
+	{
+		std::cout << std::endl << "# Module " << m + 1 << ": *" << modules[m].name << "* (" << modules[m].path << ")" << std::endl;
+		bool failed = false;
+		for (Job const& job : jobs)
+		{
+			if (job.module != (int)m) continue;
+			std::cout << job.report;
+			tests++;
+			aborted += job.result.aborted;
+			skipped += job.outcome == "skipped";
+			passes += job.result.passes;
+			fails += job.result.fails;
+			failed = failed || job.outcome != "passed";
+		}
+		if (failed) failedModules++;
+	}
+	
+	std::cout << std::fixed << std::setprecision(3);
+	double leftTime = 0;
+	if (!left.empty())
+	{
+		std::cout << std::endl << " Not run within the time budget" << std::endl;
+		std::cout << "------------------------------------------------" << std::endl;
+		for (Job const& job : left)
+		{
+			std::cout << "- *" << modules[job.module].name << "*: *" << modules[job.module].tests[job.test] << "* (about "
+				<< job.estimate << " s, failure probability " << std::setprecision(1) << job.probability * 100 << " %)" << std::setprecision(3) << std::endl;
+			leftTime += job.estimate;
+		}
+	}
+	
+	std::cout << std::endl << " Summary" << std::endl;
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "- Modules: " << modules.size() << " (" << failedModules << " failed), " << workers.size() << " workers" << std::endl;
+	std::cout << "- Tests: " << tests << " (" << aborted << " aborted, " << skipped << " skipped)" << std::endl;
+	std::cout << "- Wall time: " << wall << " s, sum of test times: " << testTime << " s" << std::endl;
+	if (budget > 0) std::cout << "- Time budget: " << budget << " s, " << left.size() << " tests not run (about " << leftTime << " s)" << std::endl;
+	if (budget > 0 && wall > budget) std::cout << "- **Over the time budget by " << wall - budget << " s**" << std::endl;
+	std::cout << "**Total passed / failed assertions: " << passes << " / " << fails << "**" << std::endl << std::endl;
+	
+	return failedModules == 0 ? 0 : 1;
+}
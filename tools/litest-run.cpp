@@ -0,0 +1,438 @@
+/**
+ @file
+ @brief litest-run, a meta-runner for LiTest executables.
+ @author  August Ernstsson <augern@icloud.com>
+ @version 1.0
+ 
+ @section LICENSE
+ Copyright (c) 2015 August Ernstsson.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ - The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ **THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.**
+ 
+ @section DESCRIPTION
+ 
+ Runs several LiTest executables in parallel and prints one merged report.
+ 
+ Usage: `litest-run [-j jobs] [-l logdir] [--pin] [--seed seed] [-b] binary[@threads]...`
+ 
+ Each binary is started with a pipe whose file descriptor is passed in the environment
+ variable named by LITEST_REPORT_FD_ENV. The TestSuite in the binary writes its results
+ to that pipe (see litest::internal::ReportPipe), so the text output of the binaries is
+ never parsed. The text output is discarded, or written to `logdir/<binary>.log`.
+ 
+ With `--pin`, each binary is pinned to its own contiguous set of CPUs, one per declared thread
+ (`binary@threads`, default 1), preferably on a single NUMA node, and allocates memory on its local
+ node. Binaries following `-b` are benchmarks: they get whole physical cores, so no other binary
+ runs on an SMT sibling of their CPUs. The CPU list is passed in the LITEST_CPUS_ENV variable, and
+ LITEST_EXCLUSIVE_CORES_ENV tells benchmarks that the siblings are reserved.
+ 
+ `--seed` sets the seed of litest::rng() in all binaries, to replay a failure of a randomized test.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "litest.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+/** Results collected from one test binary. */
+struct Job
+{
+	/** Path of the binary. */
+	std::string path;
+	
+	/** Number of threads the binary declared it runs. */
+	int threads = 1;
+	
+	/** Whether the binary runs benchmarks and needs exclusive cores. */
+	bool benchmark = false;
+	
+	/** CPUs the binary was pinned to. */
+	litest::placement::Allocation cpus;
+	
+	/** Names of the test suites run by the binary. */
+	std::vector<std::string> suites;
+	
+	/** Number of tests run. */
+	long long tests = 0;
+	
+	/** Number of aborted tests. */
+	long long aborted = 0;
+	
+	/** Passed assertions. */
+	long long passes = 0;
+	
+	/** Failed assertions. */
+	long long fails = 0;
+	
+	/** Number of suite starts without a matching suite end. */
+	int openSuites = 0;
+	
+	/** Name and duration of the slowest test. */
+	std::string slowestTest;
+	double slowestDuration = 0;
+	
+	/** Process state. */
+	pid_t pid = -1;
+	int fd = -1;
+	int status = 0;
+	bool started = false;
+	bool finished = false;
+	
+	/** Worker slot the binary ran in. */
+	int slot = -1;
+	
+	/** Start and end time relative to the start of the run, in seconds. */
+	double start = 0, end = 0;
+	
+	/** Incomplete protocol line. */
+	std::string buffer;
+	
+	/**
+	 Whether the binary passed.
+	 @return `true` if it exited normally with status 0, completed all its suites and had no failures.
+	 */
+	bool passed() const
+	{
+		return this->exitedCleanly() && this->fails == 0 && this->aborted == 0;
+	}
+	
+	/**
+	 Whether the binary exited normally with status 0 and completed all its suites.
+	 @return `true` if the binary did not crash.
+	 */
+	bool exitedCleanly() const
+	{
+		return WIFEXITED(this->status) && WEXITSTATUS(this->status) == 0 && this->openSuites == 0 && !this->suites.empty();
+	}
+	
+	/**
+	 Describe how the process ended, for failed binaries.
+	 @return Description of the exit status.
+	 */
+	std::string exitDescription() const
+	{
+		std::stringstream ss;
+		if (WIFSIGNALED(this->status)) ss << "killed by signal " << WTERMSIG(this->status) << " (" << strsignal(WTERMSIG(this->status)) << ")";
+		else if (WEXITSTATUS(this->status) == 127 && this->suites.empty()) ss << "could not be executed";
+		else if (WEXITSTATUS(this->status) != 0) ss << "exit status " << WEXITSTATUS(this->status);
+		else if (this->suites.empty()) ss << "no LiTest results reported";
+		else if (this->openSuites > 0) ss << "exited during a test suite";
+		return ss.str();
+	}
+	
+	/**
+	 Handle one protocol record.
+	 @param line Record without the line break.
+	 */
+	void record(std::string const& line)
+	{
+		std::vector<std::string> fields;
+		std::stringstream ss(line);
+		std::string field;
+		while (std::getline(ss, field, '\t')) fields.push_back(field);
+		if (fields.empty()) return;
+		
+		if (fields[0] == "S" && fields.size() >= 2)
+		{
+			this->suites.push_back(fields[1]);
+			this->openSuites++;
+		}
+		else if (fields[0] == "T" && fields.size() >= 7)
+		{
+			this->tests++;
+			this->passes += std::atoll(fields[2].c_str());
+			this->fails += std::atoll(fields[3].c_str());
+			if (fields[4] != "0") this->aborted++;
+			double duration = std::atof(fields[5].c_str());
+			if (duration > this->slowestDuration)
+			{
+				this->slowestDuration = duration;
+				this->slowestTest = fields[6];
+			}
+		}
+		else if (fields[0] == "E")
+		{
+			this->openSuites--;
+		}
+	}
+	
+	/**
+	 Handle data read from the pipe.
+	 @param data Bytes read.
+	 @param size Number of bytes.
+	 */
+	void consume(const char *data, size_t size)
+	{
+		this->buffer.append(data, size);
+		size_t pos;
+		while ((pos = this->buffer.find('\n')) != std::string::npos)
+		{
+			this->record(this->buffer.substr(0, pos));
+			this->buffer.erase(0, pos + 1);
+		}
+	}
+};
+
+/**
+ Start a binary.
+ @param job The job to start.
+ @param logDir Directory for the text output, or empty to discard it.
+ @return `true` if a process was created.
+ */
+static bool launch(Job &job, std::string const& logDir)
+{
+	int fds[2];
+	if (pipe(fds) != 0) return false;
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	
+	std::string logPath = "/dev/null";
+	if (!logDir.empty())
+	{
+		std::string base = job.path.substr(job.path.find_last_of('/') + 1);
+		logPath = logDir + "/" + base + ".log";
+	}
+	
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	if (pid == 0)
+	{
+		// Only this child may inherit its own write end
+		fcntl(fds[1], F_SETFD, 0);
+		std::string fdstr = std::to_string(fds[1]);
+		setenv(LITEST_REPORT_FD_ENV, fdstr.c_str(), 1);
+		
+		// CPU affinity and memory policy are inherited through exec
+		if (job.cpus)
+		{
+			litest::placement::pinCurrentThread(job.cpus.cpus);
+			litest::placement::preferLocalMemory();
+			setenv(LITEST_CPUS_ENV, litest::placement::formatCpuList(job.cpus.cpus).c_str(), 1);
+			if (job.benchmark) setenv(LITEST_EXCLUSIVE_CORES_ENV, "1", 1);
+		}
+		
+		int log = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (log >= 0)
+		{
+			dup2(log, STDOUT_FILENO);
+			dup2(log, STDERR_FILENO);
+			close(log);
+		}
+		execl(job.path.c_str(), job.path.c_str(), (char*)nullptr);
+		_exit(127);
+	}
+	
+	close(fds[1]);
+	job.pid = pid;
+	job.fd = fds[0];
+	job.started = true;
+	return true;
+}
+
+/** Print usage information. */
+static void usage(const char *prog)
+{
+	std::cerr << "Usage: " << prog << " [-j jobs] [-l logdir] [--pin] [--seed seed] [-b] binary[@threads]..." << std::endl;
+}
+
+/** The main function. */
+int main(int argc, char *argv[])
+{
+	int jobLimit = std::max(1u, std::thread::hardware_concurrency());
+	std::string logDir;
+	std::vector<Job> jobs;
+	bool pin = false, benchmarks = false;
+	
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc) jobLimit = std::max(1, std::atoi(argv[++i]));
+		else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) jobLimit = std::max(1, std::atoi(arg.c_str() + 2));
+		else if (arg == "-l" && i + 1 < argc) logDir = argv[++i];
+		else if (arg == "--pin") pin = true;
+		else if (arg == "--seed" && i + 1 < argc) setenv(LITEST_SEED_ENV, argv[++i], 1);
+		else if (arg == "-b") benchmarks = true;
+		else if (arg == "-h" || arg == "--help") { usage(argv[0]); return 0; }
+		else if (!arg.empty() && arg[0] == '-') { usage(argv[0]); return 2; }
+		else
+		{
+			jobs.emplace_back();
+			size_t at = arg.find_last_of('@');
+			if (at != std::string::npos && at + 1 < arg.size() && arg.find_first_not_of("0123456789", at + 1) == std::string::npos)
+			{
+				jobs.back().threads = std::max(1, std::atoi(arg.c_str() + at + 1));
+				arg.erase(at);
+			}
+			jobs.back().path = arg;
+			jobs.back().benchmark = benchmarks;
+		}
+	}
+	if (jobs.empty()) { usage(argv[0]); return 2; }
+	
+	signal(SIGPIPE, SIG_IGN);
+	auto runStart = Clock::now();
+	auto now = [&] { return std::chrono::duration<double>(Clock::now() - runStart).count(); };
+	
+	litest::placement::CpuAllocator allocator;
+	std::vector<int> slotFree(jobLimit, 1);
+	size_t next = 0, running = 0, done = 0;
+	
+	while (done < jobs.size())
+	{
+		// Fill free worker slots
+		while (running < (size_t)jobLimit && next < jobs.size())
+		{
+			Job &job = jobs[next];
+			if (pin)
+			{
+				// Wait for running binaries to release CPUs
+				job.cpus = allocator.allocate(job.threads, job.benchmark);
+				if (!job.cpus && running > 0) break;
+			}
+			next++;
+			int slot = (int)(std::find(slotFree.begin(), slotFree.end(), 1) - slotFree.begin());
+			job.slot = slot;
+			job.start = now();
+			if (!launch(job, logDir))
+			{
+				allocator.release(job.cpus);
+				job.status = 127 << 8;
+				job.finished = true;
+				job.end = job.start;
+				done++;
+				continue;
+			}
+			slotFree[slot] = 0;
+			running++;
+		}
+		
+		std::vector<pollfd> pfds;
+		std::vector<Job*> polled;
+		for (Job &job : jobs)
+			if (job.started && !job.finished)
+			{
+				pfds.push_back({ job.fd, POLLIN, 0 });
+				polled.push_back(&job);
+			}
+		if (pfds.empty()) continue;
+		
+		if (poll(pfds.data(), pfds.size(), -1) < 0) continue;
+		
+		for (size_t i = 0; i < pfds.size(); ++i)
+		{
+			if (!pfds[i].revents) continue;
+			Job &job = *polled[i];
+			char buf[4096];
+			ssize_t n = read(job.fd, buf, sizeof buf);
+			if (n > 0) { job.consume(buf, n); continue; }
+			if (n < 0 && errno == EINTR) continue;
+			
+			// End of stream: the binary has exited (or closed the pipe)
+			close(job.fd);
+			waitpid(job.pid, &job.status, 0);
+			job.end = now();
+			job.finished = true;
+			slotFree[job.slot] = 1;
+			allocator.release(job.cpus);
+			running--;
+			done++;
+		}
+	}
+	double wall = now();
+	
+	// Report
+	long long tests = 0, aborted = 0, passes = 0, fails = 0;
+	double cpuSum = 0;
+	int failedBinaries = 0;
+	
+	std::cout << std::fixed << std::setprecision(3);
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		Job const& job = jobs[i];
+		tests += job.tests; aborted += job.aborted; passes += job.passes; fails += job.fails;
+		cpuSum += job.end - job.start;
+		if (!job.passed()) failedBinaries++;
+		
+		std::cout << std::endl << " Binary " << i + 1 << ": *" << job.path << "*";
+		for (std::string const& suite : job.suites) std::cout << " *" << suite << "*";
+		std::cout << std::endl << "------------------------------------------------" << std::endl;
+		std::cout << "- Result: " << (job.passed() ? "passed" : "**failed**");
+		if (!job.exitedCleanly()) std::cout << " (" << job.exitDescription() << ")";
+		std::cout << std::endl;
+		std::cout << "- Tests: " << job.tests << " (" << job.aborted << " aborted)" << std::endl;
+		std::cout << "- Passed / failed assertions: " << job.passes << " / " << job.fails << std::endl;
+		std::cout << "- Time: " << job.end - job.start << " s (worker " << job.slot + 1 << ", " << job.start << " s to " << job.end << " s)" << std::endl;
+		if (job.cpus)
+			std::cout << "- CPUs: " << litest::placement::formatCpuList(job.cpus.cpus) << (job.benchmark ? " (exclusive cores)" : "") << std::endl;
+		if (!job.slowestTest.empty())
+			std::cout << "- Slowest test: *" << job.slowestTest << "* (" << job.slowestDuration << " s)" << std::endl;
+	}
+	
+	// The binaries are independent, so the longest one bounds the wall time from below;
+	// the chain of binaries on the worker that finished last shows how close the schedule came.
+	int lastSlot = -1;
+	double lastEnd = -1;
+	Job const* longest = nullptr;
+	for (Job const& job : jobs)
+	{
+		if (job.end > lastEnd) { lastEnd = job.end; lastSlot = job.slot; }
+		if (!longest || job.end - job.start > longest->end - longest->start) longest = &job;
+	}
+	
+	std::cout << std::endl << " Summary" << std::endl;
+	std::cout << "------------------------------------------------" << std::endl;
+	std::cout << "- Binaries: " << jobs.size() << " (" << failedBinaries << " failed), " << jobLimit << " parallel jobs" << std::endl;
+	std::cout << "- Tests: " << tests << " (" << aborted << " aborted)" << std::endl;
+	std::cout << "- Wall time: " << wall << " s, sum of binary times: " << cpuSum << " s" << std::endl;
+	if (longest)
+		std::cout << "- Longest binary: *" << longest->path << "* (" << longest->end - longest->start << " s)" << std::endl;
+	std::cout << "- Last worker to finish (worker " << lastSlot + 1 << "):";
+	double pathTime = 0;
+	for (Job const& job : jobs)
+		if (job.slot == lastSlot)
+		{
+			std::cout << " *" << job.path << "* (" << job.end - job.start << " s)";
+			pathTime += job.end - job.start;
+		}
+	std::cout << " = " << pathTime << " s" << std::endl;
+	std::cout << "**Total passed / failed assertions: " << passes << " / " << fails << "**" << std::endl << std::endl;
+	
+	return failedBinaries == 0 ? 0 : 1;
+}
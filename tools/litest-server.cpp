@@ -0,0 +1,384 @@
+/**
+ @file
+ @brief litest-server, a long-lived runner that hot-reloads LiTest modules.
+ @author  August Ernstsson <augern@icloud.com>
+ @version 1.0
+ 
+ @section LICENSE
+ Copyright (c) 2015 August Ernstsson.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ - The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ **THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.**
+ 
+ @section DESCRIPTION
+ 
+ Loads test modules (shared objects defined with LT_MODULE) into one process and runs their tests on request.
+ 
+ Usage: `litest-server [-s socket] module.so...`
+ 
+ Requests arrive on a Unix domain socket (default `.litest-server.sock`), one line per connection:
+ 
+ - `run [filter]` runs the tests whose names contain one of the comma-separated parts of `filter`,
+   in every module, writes the report to the connection and closes it.
+ - `watch [filter]` does the same, then keeps the connection and reruns the tests each time a module is rebuilt.
+ - `quit` stops the server.
+ 
+ Each run ends with a line `#litest-server<TAB>failed<TAB>milliseconds`, which `litest-client` turns into its
+ exit status. The directories of the modules are watched with inotify. When a module is rewritten, it is loaded
+ again from a private copy, as the dynamic loader would otherwise keep returning the old code for its path.
+ Modules stay loaded, with their static state, between runs of an unchanged build.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "litest.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+/** Entry point of a module; see LT_MODULE. */
+typedef int (*ModuleRun)(const char *filter, int fd);
+
+/** A loaded test module. */
+struct Module
+{
+	/** Path of the shared object, as given. */
+	std::string path;
+	
+	/** Handle of the loaded copy, or `nullptr`. */
+	void *handle = nullptr;
+	
+	/** Entry point of the loaded copy. */
+	ModuleRun run = nullptr;
+	
+	/** Identity of the loaded file, to tell whether it was rebuilt. */
+	dev_t device = 0;
+	ino_t inode = 0;
+	struct timespec modified = {0, 0};
+	off_t size = 0;
+	
+	/** Number of times the module was loaded. */
+	int generation = 0;
+	
+	/** Error of the last load, if it failed. */
+	std::string error;
+	
+	/**
+	 Whether the file differs from the loaded one.
+	 @return `true` if the module has to be loaded.
+	 */
+	bool changed() const
+	{
+		struct stat st;
+		if (stat(this->path.c_str(), &st) != 0) return false;
+		return !this->handle || st.st_dev != this->device || st.st_ino != this->inode || st.st_size != this->size
+			|| st.st_mtim.tv_sec != this->modified.tv_sec || st.st_mtim.tv_nsec != this->modified.tv_nsec;
+	}
+	
+	/**
+	 Load the current file, through a private copy in `dir`.
+	 The previous copy is closed; with a failed load, the previous copy stays in use.
+	 @param dir Directory for the copies.
+	 @return `true` if the new file was loaded.
+	 */
+	bool load(std::string const& dir)
+	{
+		struct stat st;
+		if (stat(this->path.c_str(), &st) != 0) { this->error = "cannot stat " + this->path; return false; }
+		
+		std::string base = this->path.substr(this->path.find_last_of('/') + 1);
+		std::string copy = dir + "/" + std::to_string(++this->generation) + "-" + base;
+		if (!copyFile(this->path, copy)) { this->error = "cannot copy " + this->path; return false; }
+		void *handle = dlopen(copy.c_str(), RTLD_NOW | RTLD_LOCAL);
+		unlink(copy.c_str());
+		if (!handle) { this->error = dlerror(); return false; }
+		ModuleRun run = (ModuleRun)dlsym(handle, "litest_module_run");
+		if (!run)
+		{
+			this->error = this->path + " does not define a module (LT_MODULE)";
+			dlclose(handle);
+			return false;
+		}
+		
+		if (this->handle) dlclose(this->handle);
+		this->handle = handle;
+		this->run = run;
+		this->device = st.st_dev;
+		this->inode = st.st_ino;
+		this->modified = st.st_mtim;
+		this->size = st.st_size;
+		this->error.clear();
+		return true;
+	}
+	
+	/**
+	 Copy a file.
+	 @param from Source path.
+	 @param to Destination path, created.
+	 @return `true` on success.
+	 */
+	static bool copyFile(std::string const& from, std::string const& to)
+	{
+		int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+		if (in < 0) return false;
+		int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0700);
+		bool ok = out >= 0;
+		char buf[65536];
+		ssize_t n;
+		while (ok && (n = read(in, buf, sizeof buf)) != 0)
+		{
+			if (n < 0 && errno == EINTR) continue;
+			ok = n > 0 && write(out, buf, n) == n;
+		}
+		close(in);
+		if (out >= 0) close(out);
+		return ok;
+	}
+};
+
+/** A client waiting for reruns. */
+struct Watcher
+{
+	/** Connection to the client. */
+	int fd;
+	
+	/** Selected tests. */
+	std::string filter;
+};
+
+/**
+ Write a string to a connection.
+ @param fd Connection.
+ @param str Text.
+ @return `true` if all of it was written.
+ */
+static bool send(int fd, std::string const& str)
+{
+	return write(fd, str.data(), str.size()) == (ssize_t)str.size();
+}
+
+/**
+ Load changed modules, and report failed loads to a connection.
+ @param modules The modules.
+ @param dir Directory for the module copies.
+ @param fd Connection to report to, or -1.
+ @return Whether any module was loaded.
+ */
+static bool reload(std::vector<Module> &modules, std::string const& dir, int fd = -1)
+{
+	bool loaded = false;
+	for (Module &module : modules)
+	{
+		if (!module.changed()) continue;
+		if (module.load(dir)) loaded = true;
+		else
+		{
+			std::cerr << "litest-server: " << module.error << std::endl;
+			if (fd >= 0) send(fd, "- **Cannot load module:** " + module.error + "\n");
+		}
+	}
+	return loaded;
+}
+
+/**
+ Run the selected tests of all modules.
+ @param modules The modules.
+ @param filter Selected tests.
+ @param fd Connection to write the report to.
+ @return `true` if the connection is still usable.
+ */
+static bool runTests(std::vector<Module> &modules, std::string const& filter, int fd)
+{
+	auto start = Clock::now();
+	int failed = 0;
+	for (Module &module : modules)
+	{
+		if (!module.run) { failed = 1; continue; }
+		if (module.run(filter.c_str(), fd) != 0) failed = 1;
+	}
+	double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	std::stringstream ss;
+	ss << "#litest-server\t" << failed << "\t" << ms << "\n";
+	return send(fd, ss.str());
+}
+
+/**
+ Run the tests of watching clients again, after modules were reloaded. Drops clients that went away.
+ @param modules The modules.
+ @param watchers The watching clients.
+ */
+static void rerun(std::vector<Module> &modules, std::vector<Watcher> &watchers)
+{
+	std::cerr << "litest-server: reloaded" << std::endl;
+	for (size_t i = 0; i < watchers.size();)
+	{
+		Watcher &watcher = watchers[i];
+		if (send(watcher.fd, "\n# Reloaded\n") && runTests(modules, watcher.filter, watcher.fd)) { i++; continue; }
+		close(watcher.fd);
+		watchers.erase(watchers.begin() + i);
+	}
+}
+
+/** Print usage information. */
+static void usage(const char *prog)
+{
+	std::cerr << "Usage: " << prog << " [-s socket] module.so..." << std::endl;
+}
+
+/** The main function. */
+int main(int argc, char *argv[])
+{
+	std::string socketPath = ".litest-server.sock";
+	std::vector<Module> modules;
+	
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-s" && i + 1 < argc) socketPath = argv[++i];
+		else if (arg == "-h" || arg == "--help") { usage(argv[0]); return 0; }
+		else if (!arg.empty() && arg[0] == '-') { usage(argv[0]); return 2; }
+		else
+		{
+			modules.emplace_back();
+			modules.back().path = arg.find('/') == std::string::npos ? "./" + arg : arg;
+		}
+	}
+	if (modules.empty()) { usage(argv[0]); return 2; }
+	
+	signal(SIGPIPE, SIG_IGN);
+	
+	char dirTemplate[] = "/tmp/litest-server-XXXXXX";
+	if (!mkdtemp(dirTemplate)) { perror("litest-server: mkdtemp"); return 1; }
+	std::string copyDir = dirTemplate;
+	reload(modules, copyDir);
+	
+	// Watch the directories, since builds often replace a module rather than rewrite it
+	int notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	for (Module const& module : modules)
+	{
+		std::string dir = module.path.substr(0, module.path.find_last_of('/'));
+		inotify_add_watch(notify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	}
+	
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof addr.sun_path) { std::cerr << "litest-server: socket path too long" << std::endl; return 1; }
+	std::strcpy(addr.sun_path, socketPath.c_str());
+	unlink(socketPath.c_str());
+	if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof addr) != 0 || listen(listener, 16) != 0)
+	{
+		perror("litest-server: socket");
+		return 1;
+	}
+	std::cerr << "litest-server: serving " << modules.size() << " modules on " << socketPath << std::endl;
+	
+	std::vector<Watcher> watchers;
+	bool pending = false;
+	Clock::time_point settle;
+	bool running = true;
+	
+	while (running)
+	{
+		// A rebuild writes the module in several steps; rerun once it has been quiet for a moment
+		int timeout = -1;
+		if (pending)
+			timeout = std::max(0, (int)std::chrono::duration_cast<std::chrono::milliseconds>(settle - Clock::now()).count());
+		
+		pollfd pfds[2] = { { listener, POLLIN, 0 }, { notify, POLLIN, 0 } };
+		if (poll(pfds, 2, timeout) < 0 && errno != EINTR) break;
+		
+		if (pfds[1].revents & POLLIN)
+		{
+			char buf[4096] __attribute__((aligned(__alignof__(inotify_event))));
+			ssize_t n;
+			while ((n = read(notify, buf, sizeof buf)) > 0)
+				for (char *p = buf; p < buf + n; p += sizeof(inotify_event) + ((inotify_event*)p)->len)
+				{
+					inotify_event *event = (inotify_event*)p;
+					if (!event->len) continue;
+					for (Module const& module : modules)
+						if (module.path.substr(module.path.find_last_of('/') + 1) == event->name)
+						{
+							pending = true;
+							settle = Clock::now() + std::chrono::milliseconds(100);
+						}
+				}
+		}
+		
+		if (pending && Clock::now() >= settle)
+		{
+			pending = false;
+			if (reload(modules, copyDir)) rerun(modules, watchers);
+		}
+		
+		if (pfds[0].revents & POLLIN)
+		{
+			int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+			if (client < 0) continue;
+			
+			// Read the request line
+			std::string line;
+			char c;
+			while (line.size() < 4096 && read(client, &c, 1) == 1 && c != '\n') line += c;
+			std::string command = line.substr(0, line.find(' '));
+			std::string filter = line.find(' ') != std::string::npos ? line.substr(line.find(' ') + 1) : "";
+			
+			if (command == "run" || command == "watch")
+			{
+				if (reload(modules, copyDir, client)) rerun(modules, watchers);
+				bool alive = runTests(modules, filter, client);
+				if (command == "watch" && alive) watchers.push_back({ client, filter });
+				else close(client);
+			}
+			else if (command == "quit")
+			{
+				running = false;
+				close(client);
+			}
+			else
+			{
+				send(client, "Unknown request: " + line + "\n");
+				close(client);
+			}
+		}
+	}
+	
+	for (Watcher const& watcher : watchers) close(watcher.fd);
+	close(listener);
+	unlink(socketPath.c_str());
+	rmdir(copyDir.c_str());
+	return 0;
+}